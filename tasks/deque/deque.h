@@ -1,133 +1,689 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
-template <typename T>
+// picks the number of elements per chunk for Deque<T>:
+// the largest power of two whose chunk fits into BYTES,
+// but never less than MIN_ELEMENTS (large T would degrade into a list)
+template <size_t BYTES = 4096, size_t MIN_ELEMENTS = 16>
+struct DequeChunkPolicy {
+  static_assert(MIN_ELEMENTS > 0 && (MIN_ELEMENTS & (MIN_ELEMENTS - 1)) == 0,
+                "MIN_ELEMENTS must be a power of two");
+
+  template <typename T>
+  static constexpr size_t chunk_size() {
+    size_t fits = BYTES / sizeof(T);
+    size_t result = 1;
+    while (result * 2 <= fits) {
+      result *= 2;
+    }
+    return (result < MIN_ELEMENTS) ? MIN_ELEMENTS : result;
+  }
+};
+
+// exactly ELEMENTS elements per chunk regardless of sizeof(T)
+template <size_t ELEMENTS>
+struct FixedChunkPolicy {
+  static_assert(ELEMENTS > 0 && (ELEMENTS & (ELEMENTS - 1)) == 0,
+                "ELEMENTS must be a power of two");
+
+  template <typename T>
+  static constexpr size_t chunk_size() {
+    return ELEMENTS;
+  }
+};
+
+// copy-on-write chunks on top of BasePolicy: copies of a Deque share its
+// chunks through per-chunk reference counts instead of copying elements,
+// a shared chunk is cloned by the first owner that changes it
+//
+// non-const iterators, references and segments taken before a copy
+// must not be used to write afterwards, take them again
+template <typename BasePolicy = DequeChunkPolicy<>>
+struct SharedChunkPolicy : BasePolicy {
+  static constexpr bool SHARED_CHUNKS = true;
+};
+
+// selects the bit-packed Deque<bool> specialization, chunks of BasePolicy
+// then hold 64-bit words of flags; a plain Deque<bool> keeps one bool per
+// element and the full Deque interface
+template <typename BasePolicy = DequeChunkPolicy<>>
+struct PackedBoolPolicy : BasePolicy {};
+
+template <typename ChunkPolicy, typename = void>
+struct DequeSharesChunks : std::false_type {};
+
+template <typename ChunkPolicy>
+struct DequeSharesChunks<ChunkPolicy,
+                         std::void_t<decltype(ChunkPolicy::SHARED_CHUNKS)>>
+    : std::bool_constant<ChunkPolicy::SHARED_CHUNKS> {};
+
+// selects the parallel constructors of Deque: the map and all chunks are
+// allocated up front on the calling thread, then up to 'threads' threads
+// construct the elements, each of them filling whole chunks
+struct DequeParallel {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+};
+
+// reads and writes Deque chunks directly, see deque_snapshot.h
+class DequeSnapshot;
+
+template <typename T, typename ChunkPolicy = DequeChunkPolicy<>,
+          typename Alloc = std::allocator<T>>
 class Deque {
  private:
-  static const size_t CHUNK_SIZE = 32;
+  friend class DequeSnapshot;
+
+  static constexpr size_t CHUNK_SIZE =
+      ChunkPolicy::template chunk_size<T>();
+  static_assert(CHUNK_SIZE > 0 && (CHUNK_SIZE & (CHUNK_SIZE - 1)) == 0,
+                "chunk size must be a power of two");
+
+  static constexpr size_t ChunkShift() {
+    size_t shift = 0;
+    while ((size_t(1) << shift) < CHUNK_SIZE) {
+      ++shift;
+    }
+    return shift;
+  }
+
+  static constexpr size_t CHUNK_SHIFT = ChunkShift();
+  static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+  // chunks released at one end are kept here and reused at the other end,
+  // so a FIFO workload stops allocating once it reaches steady state
+  static constexpr size_t SPARE_CHUNKS = 4;
+
+  static constexpr bool SHARED_CHUNKS = DequeSharesChunks<ChunkPolicy>::value;
+
+  // with SHARED_CHUNKS every chunk is the storage of a SharedChunk;
+  // a chunk referenced by several deques is never changed in place, so
+  // all of its owners see the same live range in it
+  struct SharedChunk {
+    std::atomic<size_t> references;
+    alignas(T) unsigned char storage[CHUNK_SIZE * sizeof(T)];
+  };
+
+  using ChunkAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using MapAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T*>;
+  using ChunkAllocTraits = std::allocator_traits<ChunkAlloc>;
+  using MapAllocTraits = std::allocator_traits<MapAlloc>;
+
+  ChunkAlloc chunk_alloc;
+  MapAlloc map_alloc;
+  // slots of rows without live elements may be nullptr
   size_t chain_size = 0;
   T** chain_array = nullptr;
   size_t deque_size = 0;
-  int first_element = 0;
+  size_t first_element = 0;
+  T* spare_chunks[SPARE_CHUNKS] = {};
+  size_t spare_count = 0;
+  // set once chunks were shared with a copy, cleared by UnshareAll
+  mutable std::atomic<bool> may_share = false;
 
   void DeleteElements() {
     for (size_t i = 0; i < deque_size; ++i) {
-      (chain_array[row(i + first_element)] + column(i + first_element))->~T();
+      ChunkAllocTraits::destroy(
+          chunk_alloc,
+          chain_array[row(i + first_element)] + column(i + first_element));
     }
   }
 
   void DeleteChunks() {
     for (size_t i = 0; i < chain_size; ++i) {
-      delete[] reinterpret_cast<char*>(chain_array[i]);
+      if (chain_array[i] != nullptr) {
+        DeallocateChunk(chain_array[i]);
+        chain_array[i] = nullptr;
+      }
+    }
+    for (size_t i = 0; i < spare_count; ++i) {
+      DeallocateChunk(spare_chunks[i]);
     }
+    spare_count = 0;
   }
 
-  void IncreaseBackCapacity(size_t new_chain_size) {
-    if (chain_size >= new_chain_size)
-      return;
+  T** AllocateMap(size_t new_chain_size) {
+    T** new_chain_array = MapAllocTraits::allocate(map_alloc, new_chain_size);
+    std::fill(new_chain_array, new_chain_array + new_chain_size, nullptr);
+    return new_chain_array;
+  }
 
-    T** new_chain_array = new T*[new_chain_size];
+  void DeallocateMap() {
+    if (chain_array != nullptr) {
+      MapAllocTraits::deallocate(map_alloc, chain_array, chain_size);
+    }
+  }
 
-    for (size_t i = 0; i < chain_size; ++i) {
-      new_chain_array[i] = chain_array[i];
+  void DeallocateChunk(T* chunk) {
+    if constexpr (SHARED_CHUNKS) {
+      SharedChunkAlloc shared_alloc(chunk_alloc);
+      SharedChunkAllocTraits::deallocate(shared_alloc, Header(chunk), 1);
+    } else {
+      ChunkAllocTraits::deallocate(chunk_alloc, chunk, CHUNK_SIZE);
     }
+  }
 
-    int added_chunks = 0;
-    try {
-      for (size_t i = chain_size; i < new_chain_size; ++i) {
-        new_chain_array[i] = allocate_raw_memory();
-        ++added_chunks;
+  using SharedChunkAlloc = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<SharedChunk>;
+  using SharedChunkAllocTraits = std::allocator_traits<SharedChunkAlloc>;
+
+  static SharedChunk* Header(T* chunk) {
+    return reinterpret_cast<SharedChunk*>(
+        reinterpret_cast<unsigned char*>(chunk) -
+        offsetof(SharedChunk, storage));
+  }
+
+  // drops a reference to a shared chunk, true if it was the last one
+  static bool DropReference(T* chunk) {
+    return Header(chunk)->references.fetch_sub(
+               1, std::memory_order_acq_rel) == 1;
+  }
+
+  // live positions of this deque inside row 'index'
+  std::pair<size_t, size_t> LiveRange(size_t index) const {
+    size_t from = std::max(first_element, index * CHUNK_SIZE);
+    size_t to = std::min(first_element + deque_size, (index + 1) * CHUNK_SIZE);
+    return {from, std::max(from, to)};
+  }
+
+  // gives row 'index' a chunk of its own before it is changed,
+  // copying the live elements out of a shared one
+  void UnshareRow(size_t index) {
+    if constexpr (SHARED_CHUNKS) {
+      T* chunk = chain_array[index];
+      if (!may_share.load(std::memory_order_relaxed) || chunk == nullptr ||
+          Header(chunk)->references.load(std::memory_order_acquire) == 1) {
+        return;
       }
-    } catch (...) {
-      for (size_t i = chain_size; i < chain_size + added_chunks; ++i) {
-        delete[] reinterpret_cast<char*>(new_chain_array[i]);
+      auto [from, to] = LiveRange(index);
+      T* copy = allocate_raw_memory();
+      size_t constructed = 0;
+      try {
+        for (; from + constructed < to; ++constructed) {
+          ChunkAllocTraits::construct(
+              chunk_alloc, copy + column(from + constructed),
+              chunk[column(from + constructed)]);
+        }
+      } catch (...) {
+        for (size_t i = 0; i < constructed; ++i) {
+          ChunkAllocTraits::destroy(chunk_alloc, copy + column(from + i));
+        }
+        DeallocateChunk(copy);
+        throw;
+      }
+      chain_array[index] = copy;
+      if (DropReference(chunk)) {
+        // the other owners went away meanwhile
+        for (size_t position = from; position < to; ++position) {
+          ChunkAllocTraits::destroy(chunk_alloc, chunk + column(position));
+        }
+        DeallocateChunk(chunk);
       }
-      delete[] new_chain_array;
-      throw;
     }
+  }
 
-    delete[] chain_array;
-    chain_array = new_chain_array;
-    chain_size = new_chain_size;
+  // before handing out non-const access to arbitrary elements
+  void UnshareAll() {
+    if constexpr (SHARED_CHUNKS) {
+      if (!may_share.load(std::memory_order_relaxed)) {
+        return;
+      }
+      for (size_t i = 0; i < LiveRows(); ++i) {
+        UnshareRow(row(first_element) + i);
+      }
+      may_share.store(false, std::memory_order_relaxed);
+    }
   }
 
-  void swap(Deque init) {
-    std::swap(chain_array, init.chain_array);
-    std::swap(chain_size, init.chain_size);
-    std::swap(first_element, init.first_element);
-    std::swap(deque_size, init.deque_size);
+  // allocates an empty map for an empty deque
+  void AllocateChain(size_t new_chain_size) {
+    if (new_chain_size == 0) {
+      return;
+    }
+    chain_array = AllocateMap(new_chain_size);
+    chain_size = new_chain_size;
   }
 
-  void IncreaseFrontCapacity(size_t new_chain_size) {
-    if (chain_size > new_chain_size) {
-      throw(
-          "you're doing something strange "
-          "why do you want to decrease capacity"
-          "with increasing method???");
-    } else if (chain_size == new_chain_size)
+  // makes sure row 'index' has a chunk, taking a spare one if possible
+  void EnsureChunk(size_t index) {
+    if (chain_array[index] != nullptr) {
       return;
+    }
+    if (spare_count != 0) {
+      chain_array[index] = spare_chunks[--spare_count];
+    } else {
+      chain_array[index] = allocate_raw_memory();
+    }
+  }
 
-    T** new_chain_array = new T*[new_chain_size];
+  // detaches chunk of row 'index' (it must hold no live elements)
+  void ReleaseChunk(size_t index) {
+    T* chunk = chain_array[index];
+    if (chunk == nullptr) {
+      return;
+    }
+    chain_array[index] = nullptr;
+    if constexpr (SHARED_CHUNKS) {
+      if (!DropReference(chunk)) {
+        return;
+      }
+      Header(chunk)->references.store(1, std::memory_order_relaxed);
+    }
+    if (spare_count < SPARE_CHUNKS) {
+      spare_chunks[spare_count++] = chunk;
+    } else {
+      DeallocateChunk(chunk);
+    }
+  }
 
-    size_t start_elements = new_chain_size - chain_size;
+  size_t LiveRows() const {
+    return (deque_size == 0) ? 0
+                             : row(first_element + deque_size - 1) -
+                                   row(first_element) + 1;
+  }
 
-    int added_chunks = 0;
-    try {
-      for (size_t i = 0; i < start_elements; ++i) {
-        new_chain_array[i] =
-            reinterpret_cast<T*>(new char[CHUNK_SIZE * sizeof(T)]);
-        ++added_chunks;
-      }
-    } catch (...) {
-      for (size_t i = 0; i < added_chunks; ++i) {
-        delete[] reinterpret_cast<char*>(new_chain_array[i]);
+  // makes room for 'rows_to_add' more rows before (add_at_front)
+  // or after the live rows: re-centers live rows inside the current map
+  // if it has enough slack, otherwise moves them into a bigger map;
+  // chunks reserved around the live rows move along with them
+  void ReserveMap(size_t rows_to_add, bool add_at_front) {
+    size_t old_first_row = row(first_element);
+    size_t old_rows = LiveRows();
+    size_t span_first = old_first_row;
+    size_t span_end = old_first_row + old_rows;
+    for (size_t i = 0; i < chain_size; ++i) {
+      if (chain_array[i] != nullptr) {
+        span_first = std::min(span_first, i);
+        span_end = std::max(span_end, i + 1);
       }
-      delete[] new_chain_array;
-      throw;
     }
+    size_t span_rows = span_end - span_first;
+    size_t new_rows = span_rows + rows_to_add;
+
+    T** new_chain_array = chain_array;
+    size_t new_chain_size = chain_size;
+    if (2 * new_rows >= chain_size) {
+      new_chain_size = chain_size + std::max(chain_size, rows_to_add) + 2;
+      new_chain_array = AllocateMap(new_chain_size);
+    }
+    size_t new_span_first = (new_chain_size - new_rows) / 2 +
+                            (add_at_front ? rows_to_add : 0);
+
+    if (new_chain_array != chain_array) {
+      std::copy(chain_array + span_first, chain_array + span_end,
+                new_chain_array + new_span_first);
+      DeallocateMap();
+      chain_array = new_chain_array;
+      chain_size = new_chain_size;
+    } else if (new_span_first < span_first) {
+      std::copy(chain_array + span_first, chain_array + span_end,
+                chain_array + new_span_first);
+      std::fill(chain_array + std::max(new_span_first + span_rows, span_first),
+                chain_array + span_end, nullptr);
+    } else if (new_span_first > span_first) {
+      std::copy_backward(chain_array + span_first, chain_array + span_end,
+                         chain_array + new_span_first + span_rows);
+      std::fill(chain_array + span_first,
+                chain_array + std::min(span_end, new_span_first), nullptr);
+    }
+    first_element = (new_span_first + old_first_row - span_first) * CHUNK_SIZE +
+                    column(first_element);
+  }
 
-    for (size_t i = start_elements; i < new_chain_size; ++i) {
-      new_chain_array[i] = chain_array[i - start_elements];
+  size_t ChunkCount() const {
+    size_t count = spare_count;
+    for (size_t i = 0; i < chain_size; ++i) {
+      count += (chain_array[i] != nullptr) ? 1 : 0;
     }
+    return count;
+  }
 
-    delete[] chain_array;
-    chain_array = new_chain_array;
-    chain_size = new_chain_size;
-    first_element = start_elements * CHUNK_SIZE + first_element;
+  // swaps everything except allocators
+  void SwapData(Deque& other) {
+    std::swap(chain_array, other.chain_array);
+    std::swap(chain_size, other.chain_size);
+    std::swap(first_element, other.first_element);
+    std::swap(deque_size, other.deque_size);
+    std::swap(spare_chunks, other.spare_chunks);
+    std::swap(spare_count, other.spare_count);
+    may_share.store(other.may_share.exchange(may_share.load()));
+  }
+
+  void SwapAllocators(Deque& other) {
+    std::swap(chunk_alloc, other.chunk_alloc);
+    std::swap(map_alloc, other.map_alloc);
   }
 
   T* allocate_raw_memory() {
-    return reinterpret_cast<T*>(new char[CHUNK_SIZE * sizeof(T)]);
+    if constexpr (SHARED_CHUNKS) {
+      SharedChunkAlloc shared_alloc(chunk_alloc);
+      SharedChunk* chunk = SharedChunkAllocTraits::allocate(shared_alloc, 1);
+      new (&chunk->references) std::atomic<size_t>(1);
+      return reinterpret_cast<T*>(chunk->storage);
+    } else {
+      return ChunkAllocTraits::allocate(chunk_alloc, CHUNK_SIZE);
+    }
   }
 
   void Clear() {
+    if constexpr (SHARED_CHUNKS) {
+      // the last owner of a chunk destroys its elements
+      for (size_t i = 0; i < chain_size; ++i) {
+        T* chunk = chain_array[i];
+        if (chunk == nullptr) {
+          continue;
+        }
+        chain_array[i] = nullptr;
+        if (DropReference(chunk)) {
+          auto [from, to] = LiveRange(i);
+          for (size_t position = from; position < to; ++position) {
+            ChunkAllocTraits::destroy(chunk_alloc, chunk + column(position));
+          }
+          DeallocateChunk(chunk);
+        }
+      }
+      for (size_t i = 0; i < spare_count; ++i) {
+        DeallocateChunk(spare_chunks[i]);
+      }
+      spare_count = 0;
+      deque_size = 0;
+      return;
+    }
     DeleteElements();
     DeleteChunks();
   }
+
+  T* Slot(size_t position) const {
+    return chain_array[row(position)] + column(position);
+  }
+
+  // moves 'count' elements from absolute position 'from' to 'to'
+  // run by run, where a run never crosses a chunk boundary;
+  // destination slots must hold live objects unless T is trivially copyable
+  void MoveRange(size_t from, size_t to, size_t count) {
+    if (from == to) {
+      return;
+    }
+    if (to < from) {
+      while (count > 0) {
+        size_t run = std::min({count, CHUNK_SIZE - column(from),
+                               CHUNK_SIZE - column(to)});
+        if constexpr (std::is_trivially_copyable_v<T>) {
+          std::memmove(Slot(to), Slot(from), run * sizeof(T));
+        } else {
+          std::move(Slot(from), Slot(from) + run, Slot(to));
+        }
+        from += run;
+        to += run;
+        count -= run;
+      }
+      return;
+    }
+    size_t from_end = from + count;
+    size_t to_end = to + count;
+    while (count > 0) {
+      size_t run = std::min(
+          {count, column(from_end - 1) + 1, column(to_end - 1) + 1});
+      T* source_end = Slot(from_end - 1) + 1;
+      T* target_end = Slot(to_end - 1) + 1;
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memmove(target_end - run, source_end - run, run * sizeof(T));
+      } else {
+        std::move_backward(source_end - run, source_end, target_end);
+      }
+      from_end -= run;
+      to_end -= run;
+      count -= run;
+    }
+  }
+
+  // makes sure 'count' slots before the first element have chunks
+  void ReserveFrontSlots(size_t count) {
+    if (count == 0) {
+      return;
+    }
+    if (first_element < count) {
+      ReserveMap((count + CHUNK_SIZE - 1) / CHUNK_SIZE, true);
+    }
+    for (size_t i = row(first_element - count); i <= row(first_element - 1);
+         ++i) {
+      EnsureChunk(i);
+    }
+  }
+
+  // makes sure 'count' slots after the last element have chunks
+  void ReserveBackSlots(size_t count) {
+    if (count == 0) {
+      return;
+    }
+    size_t end_position = first_element + deque_size;
+    if (row(end_position + count - 1) >= chain_size) {
+      ReserveMap((count + CHUNK_SIZE - 1) / CHUNK_SIZE + 1, false);
+      end_position = first_element + deque_size;
+    }
+    for (size_t i = row(end_position); i <= row(end_position + count - 1);
+         ++i) {
+      EnsureChunk(i);
+    }
+  }
+
+  // calls 'construct(place, i)' for the free slots [from, from + count),
+  // on exception destroys what was constructed
+  template <typename Constructor>
+  void ConstructSlots(size_t from, size_t count, Constructor construct) {
+    size_t constructed = 0;
+    try {
+      for (; constructed < count; ++constructed) {
+        construct(Slot(from + constructed), constructed);
+      }
+    } catch (...) {
+      for (size_t i = 0; i < constructed; ++i) {
+        ChunkAllocTraits::destroy(chunk_alloc, Slot(from + i));
+      }
+      throw;
+    }
+  }
+
+  // constructs elements [0, count) at 'first_element' onwards into
+  // chunks that are already attached, on up to 'threads' threads;
+  // 'construct_run(position, run)' builds the elements at absolute
+  // positions [position, position + run) of one chunk, all or nothing;
+  // if anything throws, every built element is destroyed and the first
+  // exception is rethrown, otherwise the elements become live
+  template <typename RunConstructor>
+  void ParallelConstructSlots(size_t count, size_t threads,
+                              RunConstructor construct_run) {
+    if (count == 0) {
+      return;
+    }
+    size_t first_row = row(first_element);
+    size_t rows = row(first_element + count - 1) - first_row + 1;
+    size_t parts = std::max<size_t>(1, std::min(threads, rows));
+    size_t rows_per_part = (rows + parts - 1) / parts;
+    auto part_begin = [&](size_t part) {
+      if (part == 0) {
+        return first_element;
+      }
+      return std::min((first_row + part * rows_per_part) * CHUNK_SIZE,
+                      first_element + count);
+    };
+
+    std::vector<size_t> built(parts, 0);
+    std::vector<std::exception_ptr> errors(parts);
+    auto work = [&](size_t part) {
+      size_t position = part_begin(part);
+      size_t end_position = part_begin(part + 1);
+      try {
+        while (position < end_position) {
+          size_t run =
+              std::min(end_position - position, CHUNK_SIZE - column(position));
+          construct_run(position, run);
+          position += run;
+        }
+      } catch (...) {
+        errors[part] = std::current_exception();
+      }
+      built[part] = position - part_begin(part);
+    };
+
+    std::vector<std::thread> workers;
+    std::exception_ptr spawn_error;
+    try {
+      workers.reserve(parts - 1);
+      for (size_t part = 1; part < parts; ++part) {
+        workers.emplace_back(work, part);
+      }
+    } catch (...) {
+      spawn_error = std::current_exception();
+    }
+    work(0);
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    std::exception_ptr error = spawn_error;
+    for (size_t part = 0; part < parts && !error; ++part) {
+      error = errors[part];
+    }
+    if (error) {
+      for (size_t part = 0; part < parts; ++part) {
+        for (size_t i = 0; i < built[part]; ++i) {
+          ChunkAllocTraits::destroy(chunk_alloc, Slot(part_begin(part) + i));
+        }
+      }
+      std::rethrow_exception(error);
+    }
+    deque_size = count;
+  }
+
+  // inserts 'count' values from 'first' before element 'index',
+  // shifting whichever side of 'index' is shorter
+  template <typename ForwardIt>
+  void InsertRange(size_t index, ForwardIt first, size_t count) {
+    if (count == 0) {
+      return;
+    }
+    if (index < deque_size - index) {
+      ReserveFrontSlots(count);
+      size_t old_first = first_element;
+      size_t moved = std::min(index, count);
+      // free slots before the front take the first 'moved' old elements
+      // followed by the leading values
+      ConstructSlots(old_first - count, count, [&](T* place, size_t i) {
+        if (i < moved) {
+          ChunkAllocTraits::construct(chunk_alloc, place,
+                                      std::move(*Slot(old_first + i)));
+        } else {
+          ChunkAllocTraits::construct(chunk_alloc, place, *first);
+          ++first;
+        }
+      });
+      first_element -= count;
+      deque_size += count;
+      MoveRange(old_first + count, old_first, index - moved);
+      for (size_t i = index - moved; i < index; ++i, ++first) {
+        *Slot(old_first + i) = *first;
+      }
+      return;
+    }
+
+    ReserveBackSlots(count);
+    size_t tail = deque_size - index;
+    size_t old_end = first_element + deque_size;
+    size_t moved = std::min(tail, count);
+    ForwardIt rest = std::next(first, moved);
+    // free slots after the back take the trailing values
+    // followed by the last 'moved' old elements
+    ConstructSlots(old_end, count, [&](T* place, size_t i) {
+      if (i < count - moved) {
+        ChunkAllocTraits::construct(chunk_alloc, place, *rest);
+        ++rest;
+      } else {
+        ChunkAllocTraits::construct(chunk_alloc, place,
+                                    std::move(*Slot(old_end - count + i)));
+      }
+    });
+    deque_size += count;
+    MoveRange(old_end - tail, old_end - tail + count, tail - moved);
+    for (size_t i = old_end - tail; i < old_end - tail + moved; ++i, ++first) {
+      *Slot(i) = *first;
+    }
+  }
  public:
+  using value_type = T;
+  using allocator_type = Alloc;
+
   static size_t row(size_t index) {
-    return index / CHUNK_SIZE;
+    return index >> CHUNK_SHIFT;
   };
 
   static size_t column(size_t index) {
-    return index % CHUNK_SIZE;
+    return index & CHUNK_MASK;
   };
 
+  static constexpr size_t chunk_size() {
+    return CHUNK_SIZE;
+  }
+
+  // keeps the element pointer and the bounds of its chunk, so stepping
+  // inside a chunk is a pointer bump and only chunk crossings touch the map;
+  // 'position' is kept for comparisons and for iterators past the live rows
   template <bool is_constant>
   class Iterator {
    private:
-    size_t position;
-    T** object_chain;
-    T* object_row = nullptr;
-    size_t chain_size;
+    using Pointer = std::conditional_t<is_constant, const T*, T*>;
+
+    size_t position = 0;
+    T** object_chain = nullptr;
+    size_t chain_size = 0;
+    Pointer current = nullptr;
+    Pointer row_begin = nullptr;
+    Pointer row_end = nullptr;
+
+    // slow path: looks the chunk of 'position' up in the map,
+    // null pointers if it has none (e.g. end() at a chunk boundary)
+    void Reload() {
+      size_t current_row = row(position);
+      if (object_chain != nullptr && current_row < chain_size &&
+          object_chain[current_row] != nullptr) {
+        row_begin = object_chain[current_row];
+        row_end = row_begin + CHUNK_SIZE;
+        current = row_begin + column(position);
+      } else {
+        current = row_begin = row_end = nullptr;
+      }
+    }
+
+    void Advance(ptrdiff_t delta) {
+      position += delta;
+      if (row_begin != nullptr) {
+        ptrdiff_t offset = (current - row_begin) + delta;
+        if (0 <= offset && offset < ptrdiff_t(CHUNK_SIZE)) {
+          current = row_begin + offset;
+          return;
+        }
+      }
+      Reload();
+    }
 
    public:
     using value_type = T;
-    using pointer = std::conditional_t<is_constant, const T*, T*>;
+    using pointer = Pointer;
     using reference = std::conditional_t<is_constant, const T&, T&>;
     using difference_type = ptrdiff_t;
     using iterator_category = std::random_access_iterator_tag;
@@ -135,29 +691,25 @@ class Deque {
     Iterator(size_t position, T** object_chain, size_t chain_size)
         : position(position),
           object_chain(object_chain),
-          object_row(nullptr),
           chain_size(chain_size) {
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
-      }
+      Reload();
     }
 
     Iterator() = default;
 
     reference operator*() const {
-      return *(object_row + column(position));
+      return *current;
     }
 
     pointer operator->() const {
-      return object_row + column(position);
+      return current;
     }
 
     Iterator& operator++() {
       ++position;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
+      ++current;
+      if (current == row_end) {
+        Reload();
       }
       return *this;
     }
@@ -170,9 +722,10 @@ class Deque {
 
     Iterator& operator--() {
       --position;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
+      if (current == row_begin) {
+        Reload();
+      } else {
+        --current;
       }
       return *this;
     }
@@ -202,44 +755,29 @@ class Deque {
       return position >= it.position;
     }
 
-    reference operator[](size_t delta) const {
-      int new_position = position + delta;
-      return object_chain[row(new_position)][column(new_position)];
+    reference operator[](difference_type delta) const {
+      return *(*this + delta);
     }
 
     Iterator& operator-=(difference_type delta) {
-      position -= delta;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
-      }
+      Advance(-delta);
       return *this;
     }
 
     Iterator& operator+=(difference_type delta) {
-      position += delta;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
-      }
+      Advance(delta);
       return *this;
     }
 
     Iterator& operator-=(const Iterator& it) {
       position -= it.position;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
-      }
+      Reload();
       return *this;
     }
 
     Iterator& operator+=(const Iterator& it) {
       position += it.position;
-      int current_row = row(position);
-      if (object_chain != nullptr && 0 <= current_row && current_row < int(chain_size)) {
-        object_row = object_chain[current_row];
-      }
+      Reload();
       return *this;
     }
 
@@ -248,20 +786,12 @@ class Deque {
     }
 
     friend Iterator operator+(Iterator other, difference_type delta) {
-      other.position += delta;
-      int current_row = row(other.position);
-      if (other.object_chain != nullptr && 0 <= current_row && current_row < int(other.chain_size)) {
-        other.object_row = other.object_chain[current_row];
-      }
+      other.Advance(delta);
       return other;
     }
 
     friend Iterator operator-(Iterator other, difference_type delta) {
-      other.position -= delta;
-      int current_row = row(other.position);
-      if (other.object_chain != nullptr && 0 <= current_row && current_row < int(other.chain_size)) {
-        other.object_row = other.object_chain[current_row];
-      }
+      other.Advance(-delta);
       return other;
     }
 
@@ -274,20 +804,19 @@ class Deque {
     }
 
     operator Iterator<true>() const {
-      return Iterator<true>(position, object_chain);
+      return Iterator<true>(position, object_chain, chain_size);
     }
-
-    friend void Deque::insert(Iterator<false> it, T value);
-    friend void Deque::erase(Iterator<false> it);
   };
 
   typedef Iterator<false> iterator;
   typedef Iterator<true> const_iterator;
 
   iterator begin() {
+    UnshareAll();
     return Iterator<false>(first_element, chain_array, chain_size);
   }
   iterator end() {
+    UnshareAll();
     return Iterator<false>(first_element + deque_size, chain_array, chain_size);
   }
 
@@ -298,10 +827,10 @@ class Deque {
     return Iterator<true>(first_element + deque_size, chain_array, chain_size);
   }
 
-  const_iterator cbegin() {
+  const_iterator cbegin() const {
     return Iterator<true>(first_element, chain_array, chain_size);
   }
-  const_iterator cend() {
+  const_iterator cend() const {
     return Iterator<true>(first_element + deque_size, chain_array, chain_size);
   }
 
@@ -319,109 +848,463 @@ class Deque {
     return std::reverse_iterator(cbegin());
   }
 
-  void insert(iterator it, T current_value) {
-    while (it != this->end()) {
-      std::swap(current_value, *(it));
-      ++it;
+  // contiguous run of elements inside one chunk
+  template <bool is_constant>
+  class Segment {
+   public:
+    using pointer = std::conditional_t<is_constant, const T*, T*>;
+
+    Segment(pointer first, pointer last)
+        : first(first),
+          last(last) {
+    }
+
+    pointer begin() const {
+      return first;
+    }
+    pointer end() const {
+      return last;
+    }
+    pointer data() const {
+      return first;
+    }
+    size_t size() const {
+      return last - first;
+    }
+
+   private:
+    pointer first;
+    pointer last;
+  };
+
+  // walks absolute positions [position, end_position) chunk by chunk
+  template <bool is_constant>
+  class SegmentIterator {
+   public:
+    using value_type = Segment<is_constant>;
+    using reference = value_type;
+    using pointer = void;
+    using difference_type = ptrdiff_t;
+    using iterator_category = std::input_iterator_tag;
+
+    SegmentIterator(size_t position, size_t end_position,
+                    T* const* object_chain)
+        : position(position),
+          end_position(end_position),
+          object_chain(object_chain) {
+    }
+
+    Segment<is_constant> operator*() const {
+      size_t run_end = std::min(end_position, (row(position) + 1) * CHUNK_SIZE);
+      T* first = object_chain[row(position)] + column(position);
+      return Segment<is_constant>(first, first + (run_end - position));
+    }
+
+    SegmentIterator& operator++() {
+      position = std::min(end_position, (row(position) + 1) * CHUNK_SIZE);
+      return *this;
+    }
+
+    SegmentIterator operator++(int) {
+      SegmentIterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const SegmentIterator& it) const {
+      return position == it.position;
+    }
+    bool operator!=(const SegmentIterator& it) const {
+      return position != it.position;
+    }
+
+   private:
+    size_t position;
+    size_t end_position;
+    T* const* object_chain;
+  };
+
+  template <bool is_constant>
+  class SegmentRange {
+   public:
+    SegmentRange(size_t first, size_t last, T* const* object_chain)
+        : first(first),
+          last(last),
+          object_chain(object_chain) {
+    }
+
+    SegmentIterator<is_constant> begin() const {
+      return SegmentIterator<is_constant>(first, last, object_chain);
+    }
+    SegmentIterator<is_constant> end() const {
+      return SegmentIterator<is_constant>(last, last, object_chain);
+    }
+
+   private:
+    size_t first;
+    size_t last;
+    T* const* object_chain;
+  };
+
+  // elements as a sequence of contiguous spans, one per chunk,
+  // so inner loops can run over plain pointers
+  SegmentRange<false> segments() {
+    UnshareAll();
+    return SegmentRange<false>(first_element, first_element + deque_size,
+                               chain_array);
+  }
+
+  SegmentRange<true> segments() const {
+    return SegmentRange<true>(first_element, first_element + deque_size,
+                              chain_array);
+  }
+
+  SegmentRange<false> segments(const_iterator first, const_iterator last) {
+    UnshareAll();
+    return SegmentRange<false>(first_element + (first - cbegin()),
+                               first_element + (last - cbegin()), chain_array);
+  }
+
+  SegmentRange<true> segments(const_iterator first,
+                              const_iterator last) const {
+    return SegmentRange<true>(first_element + (first - cbegin()),
+                              first_element + (last - cbegin()), chain_array);
+  }
+
+  // inserts before 'it', shifting the shorter side of the deque
+  iterator insert(const_iterator it, const T& value) {
+    return emplace(it, value);
+  }
+
+  iterator insert(const_iterator it, T&& value) {
+    size_t index = it - cbegin();
+    UnshareAll();
+    InsertRange(index, std::make_move_iterator(&value), 1);
+    return begin() + index;
+  }
+
+  template <
+      typename InputIt,
+      typename = typename std::iterator_traits<InputIt>::iterator_category>
+  iterator insert(const_iterator it, InputIt first, InputIt last) {
+    size_t index = it - cbegin();
+    UnshareAll();
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+      InsertRange(index, first, std::distance(first, last));
+    } else {
+      Deque buffer(get_allocator());
+      for (; first != last; ++first) {
+        buffer.emplace_back(*first);
+      }
+      InsertRange(index, std::make_move_iterator(buffer.begin()),
+                  buffer.size());
     }
-    this->push_back(current_value);
+    return begin() + index;
   }
 
-  void erase(iterator it) {
-    while ((it + 1) < this->end()) {
-      std::swap(*it, *(it + 1));
-      ++it;
+  template <typename... Args>
+  iterator emplace(const_iterator it, Args&&... args) {
+    size_t index = it - cbegin();
+    UnshareAll();
+    if (index == 0) {
+      emplace_front(std::forward<Args>(args)...);
+    } else if (index == deque_size) {
+      emplace_back(std::forward<Args>(args)...);
+    } else {
+      // 'args' may alias elements that are about to be shifted
+      T value(std::forward<Args>(args)...);
+      InsertRange(index, std::make_move_iterator(&value), 1);
     }
-    pop_back();
+    return begin() + index;
   }
 
-  Deque() = default;
+  iterator erase(const_iterator it) {
+    return erase(it, it + 1);
+  }
 
-  Deque(size_t new_size)
-      : chain_size((new_size + CHUNK_SIZE - 1) / CHUNK_SIZE),
-        chain_array(new T*[chain_size]) {
-    for (size_t i = 0; i < chain_size; ++i) {
-      chain_array[i] = allocate_raw_memory();
+  // removes [first, last), shifting the shorter side of the deque
+  iterator erase(const_iterator first, const_iterator last) {
+    size_t index = first - cbegin();
+    size_t count = last - first;
+    UnshareAll();
+    if (index < deque_size - index - count) {
+      MoveRange(first_element, first_element + count, index);
+      for (size_t i = 0; i < count; ++i) {
+        pop_front();
+      }
+    } else {
+      MoveRange(first_element + index + count, first_element + index,
+                deque_size - index - count);
+      for (size_t i = 0; i < count; ++i) {
+        pop_back();
+      }
     }
+    return begin() + index;
+  }
+
+  Deque()
+      : Deque(Alloc()) {
+  }
+
+  explicit Deque(const Alloc& init_allocator)
+      : chunk_alloc(init_allocator),
+        map_alloc(init_allocator) {
+  }
+
+  Deque(size_t new_size, const Alloc& init_allocator = Alloc())
+      : Deque(DequeParallel{1}, new_size, init_allocator) {
+  }
+
+  Deque(size_t new_size, const T& value,
+        const Alloc& init_allocator = Alloc())
+      : Deque(DequeParallel{1}, new_size, value, init_allocator) {
+  }
+
+  Deque(DequeParallel parallel, size_t new_size,
+        const Alloc& init_allocator = Alloc())
+      : chunk_alloc(init_allocator),
+        map_alloc(init_allocator) {
+    AllocateChain((new_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
 
     try {
-      first_element = 0;
-      for (size_t i = 0; i < new_size; ++i) {
-        new (chain_array[row(i)] + column(i)) T();
-        ++deque_size;
+      for (size_t i = 0; i < chain_size; ++i) {
+        EnsureChunk(i);
       }
+      ParallelConstructSlots(
+          new_size, parallel.threads, [&](size_t position, size_t run) {
+            ConstructSlots(position, run, [&](T* place, size_t) {
+              ChunkAllocTraits::construct(chunk_alloc, place);
+            });
+          });
     } catch (...) {
       Clear();
-      delete[] chain_array;
-      chain_size = deque_size = 0;
-      first_element = -1;
+      DeallocateMap();
       throw;
     }
   }
 
-  Deque(size_t new_size, const T& value)
-      : chain_size((new_size + CHUNK_SIZE - 1) / CHUNK_SIZE),
-        chain_array(new T*[chain_size]) {
-    for (size_t i = 0; i < chain_size; ++i) {
-      chain_array[i] = allocate_raw_memory();
-    }
+  Deque(DequeParallel parallel, size_t new_size, const T& value,
+        const Alloc& init_allocator = Alloc())
+      : chunk_alloc(init_allocator),
+        map_alloc(init_allocator) {
+    AllocateChain((new_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
 
     try {
-      first_element = 0;
-      for (size_t i = 0; i < new_size; ++i) {
-        new (chain_array[row(i)] + column(i)) T(value);
-        ++deque_size;
+      for (size_t i = 0; i < chain_size; ++i) {
+        EnsureChunk(i);
       }
+      ParallelConstructSlots(
+          new_size, parallel.threads, [&](size_t position, size_t run) {
+            ConstructSlots(position, run, [&](T* place, size_t) {
+              ChunkAllocTraits::construct(chunk_alloc, place, value);
+            });
+          });
     } catch (...) {
       Clear();
-      delete[] chain_array;
-      chain_size = deque_size = 0;
-      first_element = -1;
+      DeallocateMap();
       throw;
     }
   }
 
   Deque(const Deque& init)
-      : chain_size(init.chain_size),
-        chain_array(new T*[chain_size]),
-        first_element(init.first_element) {
-    for (size_t i = 0; i < chain_size; ++i) {
-      chain_array[i] = allocate_raw_memory();
+      : Deque(init, ChunkAllocTraits::select_on_container_copy_construction(
+                        init.chunk_alloc)) {
+  }
+
+  Deque(const Deque& init, const Alloc& init_allocator)
+      : Deque(DequeParallel{1}, init, init_allocator) {
+  }
+
+  Deque(DequeParallel parallel, const Deque& init)
+      : Deque(parallel, init,
+              ChunkAllocTraits::select_on_container_copy_construction(
+                  init.chunk_alloc)) {
+  }
+
+  // keeps the layout of 'init', so both sides of every run lie
+  // in a single chunk and trivially copyable runs are copied by memcpy;
+  // with SHARED_CHUNKS and equal allocators only the map is copied
+  Deque(DequeParallel parallel, const Deque& init,
+        const Alloc& init_allocator)
+      : chunk_alloc(init_allocator),
+        map_alloc(init_allocator) {
+    AllocateChain(init.chain_size);
+    first_element = init.first_element;
+
+    if constexpr (SHARED_CHUNKS) {
+      if (chunk_alloc == init.chunk_alloc && init.deque_size != 0) {
+        size_t first_row = row(first_element);
+        for (size_t i = first_row; i < first_row + init.LiveRows(); ++i) {
+          chain_array[i] = init.chain_array[i];
+          Header(chain_array[i])->references.fetch_add(
+              1, std::memory_order_relaxed);
+        }
+        deque_size = init.deque_size;
+        may_share.store(true, std::memory_order_relaxed);
+        init.may_share.store(true, std::memory_order_relaxed);
+        return;
+      }
+    }
+
+    try {
+      for (size_t i = 0; i < init.deque_size; i += CHUNK_SIZE) {
+        EnsureChunk(row(i + first_element));
+      }
+      if (init.deque_size != 0) {
+        EnsureChunk(row(init.deque_size - 1 + first_element));
+      }
+      ParallelConstructSlots(
+          init.deque_size, parallel.threads, [&](size_t position, size_t run) {
+            if constexpr (std::is_trivially_copyable_v<T>) {
+              std::memcpy(Slot(position), init.Slot(position),
+                          run * sizeof(T));
+            } else {
+              ConstructSlots(position, run, [&](T* place, size_t i) {
+                ChunkAllocTraits::construct(chunk_alloc, place,
+                                            *init.Slot(position + i));
+              });
+            }
+          });
+    } catch (...) {
+      Clear();
+      DeallocateMap();
+      throw;
     }
+  }
 
+  Deque(Deque&& init)
+      : chunk_alloc(std::move(init.chunk_alloc)),
+        map_alloc(std::move(init.map_alloc)),
+        chain_size(init.chain_size),
+        chain_array(init.chain_array),
+        deque_size(init.deque_size),
+        first_element(init.first_element),
+        spare_count(init.spare_count),
+        may_share(init.may_share.load()) {
+    std::copy(init.spare_chunks, init.spare_chunks + spare_count,
+              spare_chunks);
+    init.chain_size = 0;
+    init.chain_array = nullptr;
+    init.deque_size = 0;
+    init.first_element = 0;
+    init.spare_count = 0;
+  }
+
+  // steals storage if allocators are equal,
+  // otherwise moves elements one by one into storage from 'init_allocator'
+  Deque(Deque&& init, const Alloc& init_allocator)
+      : chunk_alloc(init_allocator),
+        map_alloc(init_allocator) {
+    if (chunk_alloc == init.chunk_alloc) {
+      SwapData(init);
+      return;
+    }
     try {
-      first_element = 0;
       for (size_t i = 0; i < init.deque_size; ++i) {
-        new (chain_array[row(i + first_element)] + column(i + first_element))
-            T(*(init.chain_array[row(i + first_element)] +
-                column(i + first_element)));
-        ++deque_size;
+        emplace_back(std::move(init[i]));
       }
     } catch (...) {
       Clear();
-      delete[] chain_array;
-      chain_size = deque_size = 0;
-      first_element = -1;
+      DeallocateMap();
       throw;
     }
   }
 
   ~Deque() {
     Clear();
-    delete[] chain_array;
+    DeallocateMap();
+  }
+
+  void swap(Deque& other) {
+    SwapData(other);
+    if constexpr (ChunkAllocTraits::propagate_on_container_swap::value) {
+      SwapAllocators(other);
+    }
   }
 
   Deque& operator=(const Deque& init) {
-    Deque copy(init);
-    swap(init);
+    constexpr bool propagate =
+        ChunkAllocTraits::propagate_on_container_copy_assignment::value;
+    Deque copy(init, propagate ? Alloc(init.chunk_alloc) : get_allocator());
+    SwapData(copy);
+    if constexpr (propagate) {
+      SwapAllocators(copy);
+    }
     return *this;
   }
 
-  size_t size() const {
-    return deque_size;
+  Deque& operator=(Deque&& init) {
+    constexpr bool propagate =
+        ChunkAllocTraits::propagate_on_container_move_assignment::value;
+    Deque new_deque(std::move(init),
+                    propagate ? Alloc(init.chunk_alloc) : get_allocator());
+    SwapData(new_deque);
+    if constexpr (propagate) {
+      SwapAllocators(new_deque);
+    }
+    return *this;
+  }
+
+  Alloc get_allocator() const {
+    return Alloc(chunk_alloc);
+  }
+
+  size_t size() const {
+    return deque_size;
+  }
+
+  // element slots in chunks owned by the deque, cached spares included
+  size_t capacity() const {
+    return ChunkCount() * CHUNK_SIZE;
+  }
+
+  // bytes held in chunks and in the chunk map
+  size_t memory_bytes() const {
+    return ChunkCount() * CHUNK_SIZE * sizeof(T) + chain_size * sizeof(T*);
+  }
+
+  // after these, 'count' push_front/push_back calls do not allocate
+  void reserve_front(size_t count) {
+    ReserveFrontSlots(count);
+  }
+
+  void reserve_back(size_t count) {
+    ReserveBackSlots(count);
+  }
+
+  // frees chunks without live elements, spares included,
+  // and shrinks the map to the live rows
+  void shrink_to_fit() {
+    size_t first_row = row(first_element);
+    size_t rows = LiveRows();
+    T** new_chain_array = chain_array;
+    if (rows != chain_size) {
+      new_chain_array = (rows == 0) ? nullptr : AllocateMap(rows);
+    }
+    for (size_t i = 0; i < chain_size; ++i) {
+      if ((i < first_row || i >= first_row + rows) &&
+          chain_array[i] != nullptr) {
+        DeallocateChunk(chain_array[i]);
+        chain_array[i] = nullptr;
+      }
+    }
+    for (size_t i = 0; i < spare_count; ++i) {
+      DeallocateChunk(spare_chunks[i]);
+    }
+    spare_count = 0;
+    if (new_chain_array != chain_array) {
+      std::copy(chain_array + first_row, chain_array + first_row + rows,
+                new_chain_array);
+      DeallocateMap();
+      chain_array = new_chain_array;
+      chain_size = rows;
+    }
+    first_element = (rows == 0) ? 0 : column(first_element);
   }
 
   T& operator[](size_t index) {
+    UnshareRow(row(index + first_element));
     return chain_array[row(index + first_element)]
                       [column(index + first_element)];
   }
@@ -435,6 +1318,7 @@ class Deque {
     if (!(0 <= index && index < deque_size)) {
       throw std::out_of_range("durak");
     }
+    UnshareRow(row(index + first_element));
     return chain_array[row(index + first_element)]
                       [column(index + first_element)];
   }
@@ -443,39 +1327,597 @@ class Deque {
     if (!(0 <= index && index < deque_size)) {
       throw std::out_of_range("loh");
     }
-    return chain_array[row(index)][column(index)];
+    return chain_array[row(index + first_element)]
+                      [column(index + first_element)];
   }
 
   void push_back(const T& value) {
-    size_t capacity = chain_size * CHUNK_SIZE;
+    emplace_back(value);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  void push_front(const T& value) {
+    emplace_front(value);
+  }
+
+  void push_front(T&& value) {
+    emplace_front(std::move(value));
+  }
+
+  // constructs new element in place from 'args'
+  // chunks are never relocated, so 'args' may refer to elements of *this
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
     size_t to_insert = first_element + deque_size;
-    if (to_insert >= capacity) {
-      IncreaseBackCapacity((chain_size == 0) ? 1 : 2 * chain_size);
+    if (row(to_insert) >= chain_size) {
+      ReserveMap(1, false);
+      to_insert = first_element + deque_size;
     }
-    new (chain_array[row(to_insert)] + column(to_insert)) T(value);
+    EnsureChunk(row(to_insert));
+    UnshareRow(row(to_insert));
+    T* place = chain_array[row(to_insert)] + column(to_insert);
+    ChunkAllocTraits::construct(chunk_alloc, place,
+                                std::forward<Args>(args)...);
     ++deque_size;
+    return *place;
   }
 
-  void push_front(const T& value) {
+  template <typename... Args>
+  T& emplace_front(Args&&... args) {
     if (first_element == 0) {
-      IncreaseFrontCapacity((chain_size == 0) ? 1 : 2 * chain_size);
+      ReserveMap(1, true);
     }
     size_t to_insert = first_element - 1;
-    new (chain_array[row(to_insert)] + column(to_insert)) T(value);
+    EnsureChunk(row(to_insert));
+    UnshareRow(row(to_insert));
+    T* place = chain_array[row(to_insert)] + column(to_insert);
+    ChunkAllocTraits::construct(chunk_alloc, place,
+                                std::forward<Args>(args)...);
     ++deque_size;
     --first_element;
+    return *place;
   }
 
   void pop_back() {
     size_t to_delete = first_element + deque_size - 1;
-    (chain_array[row(to_delete)] + column(to_delete))->~T();
+    UnshareRow(row(to_delete));
+    ChunkAllocTraits::destroy(chunk_alloc,
+                              chain_array[row(to_delete)] + column(to_delete));
     --deque_size;
+    if (column(to_delete) == 0) {
+      ReleaseChunk(row(to_delete));
+    }
   }
 
   void pop_front() {
     size_t to_delete = first_element;
-    (chain_array[row(to_delete)] + column(to_delete))->~T();
+    UnshareRow(row(to_delete));
+    ChunkAllocTraits::destroy(chunk_alloc,
+                              chain_array[row(to_delete)] + column(to_delete));
     --deque_size;
     ++first_element;
+    if (column(first_element) == 0) {
+      ReleaseChunk(row(to_delete));
+    }
+  }
+
+  // moves up to 'count' front elements to 'out' and pops them, a chunk
+  // run at a time: one bookkeeping update and at most one chunk release
+  // per run instead of per element; returns the end of the output
+  template <typename OutputIt>
+  OutputIt pop_front_n(size_t count, OutputIt out) {
+    count = std::min(count, deque_size);
+    while (count != 0) {
+      size_t position = first_element;
+      size_t run = std::min(count, CHUNK_SIZE - column(position));
+      UnshareRow(row(position));
+      T* first = Slot(position);
+      out = std::move(first, first + run, out);
+      if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (size_t i = 0; i < run; ++i) {
+          ChunkAllocTraits::destroy(chunk_alloc, first + i);
+        }
+      }
+      first_element += run;
+      deque_size -= run;
+      count -= run;
+      if (column(first_element) == 0) {
+        ReleaseChunk(row(position));
+      }
+    }
+    return out;
+  }
+
+  // move-assigns front elements into [first, last) until either runs out,
+  // returns the end of the filled part
+  T* drain_into(T* first, T* last) {
+    return pop_front_n(last - first, first);
+  }
+
+  // appends [first, last): slots for a forward range are reserved once,
+  // then filled chunk by chunk, by memcpy for trivially copyable T
+  // read from pointers; on exception the values appended so far stay
+  template <
+      typename InputIt,
+      typename = typename std::iterator_traits<InputIt>::iterator_category>
+  void push_back_range(InputIt first, InputIt last) {
+    using Category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (!std::is_base_of_v<std::forward_iterator_tag, Category>) {
+      for (; first != last; ++first) {
+        emplace_back(*first);
+      }
+    } else {
+      size_t count = std::distance(first, last);
+      ReserveBackSlots(count);
+      while (count != 0) {
+        size_t position = first_element + deque_size;
+        size_t run = std::min(count, CHUNK_SIZE - column(position));
+        UnshareRow(row(position));
+        if constexpr (std::is_pointer_v<InputIt> &&
+                      std::is_trivially_copyable_v<T> &&
+                      std::is_same_v<std::remove_cv_t<std::remove_pointer_t<
+                                         InputIt>>,
+                                     T>) {
+          std::memcpy(Slot(position), first, run * sizeof(T));
+          first += run;
+        } else {
+          ConstructSlots(position, run, [&](T* place, size_t) {
+            ChunkAllocTraits::construct(chunk_alloc, place, *first);
+            ++first;
+          });
+        }
+        deque_size += run;
+        count -= run;
+      }
+    }
+  }
+};
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define DEQUE_POPCNT_X86 1
+#else
+#define DEQUE_POPCNT_X86 0
+#endif
+
+// one bit per element: bits live in a Deque of 64-bit words, bit i is
+// bit (first_bit + i) % 64 of word (first_bit + i) / 64, so both ends grow
+// and shrink in O(1) and chunks hold 64 times as many elements;
+// elements are accessed through proxy references, like std::vector<bool>
+//
+// opt-in through PackedBoolPolicy, e.g. Deque<bool, PackedBoolPolicy<>>;
+// insert/erase in the middle and segments() are not provided
+template <typename BasePolicy, typename Alloc>
+class Deque<bool, PackedBoolPolicy<BasePolicy>, Alloc> {
+ private:
+  static constexpr size_t WORD_BITS = 64;
+
+  using WordAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<uint64_t>;
+  using Words = Deque<uint64_t, BasePolicy, WordAlloc>;
+
+  Words words;
+  // offset of element 0 in words[0], below WORD_BITS
+  size_t first_bit = 0;
+  size_t bit_size = 0;
+
+  static uint64_t Mask(size_t position) {
+    return uint64_t(1) << (position % WORD_BITS);
+  }
+
+  static size_t PopCount(uint64_t word) {
+    return size_t(__builtin_popcountll(word));
+  }
+
+#if DEQUE_POPCNT_X86
+  __attribute__((target("popcnt"))) static size_t PopCountHardware(
+      const uint64_t* first, size_t count) {
+    size_t result = 0;
+    for (size_t i = 0; i < count; ++i) {
+      result += size_t(__builtin_popcountll(first[i]));
+    }
+    return result;
+  }
+#endif
+
+  // the popcnt instruction where the CPU has it, checked once
+  static size_t PopCount(const uint64_t* first, size_t count) {
+#if DEQUE_POPCNT_X86
+    static const bool has_popcnt = (__builtin_cpu_init(),
+                                    __builtin_cpu_supports("popcnt"));
+    if (has_popcnt) {
+      return PopCountHardware(first, count);
+    }
+#endif
+    size_t result = 0;
+    for (size_t i = 0; i < count; ++i) {
+      result += PopCount(first[i]);
+    }
+    return result;
+  }
+
+  // masks of the bits of [from, to) in its first and last word
+  static uint64_t HeadMask(size_t from) {
+    return ~uint64_t(0) << (from % WORD_BITS);
+  }
+
+  static uint64_t TailMask(size_t to) {
+    return ~uint64_t(0) >> (WORD_BITS - 1 - (to - 1) % WORD_BITS);
+  }
+
+ public:
+  using value_type = bool;
+  using allocator_type = Alloc;
+
+  class reference {
+   private:
+    uint64_t* word;
+    uint64_t mask;
+
+   public:
+    reference(uint64_t* word, uint64_t mask)
+        : word(word),
+          mask(mask) {
+    }
+
+    operator bool() const {
+      return (*word & mask) != 0;
+    }
+
+    reference& operator=(bool value) {
+      if (value) {
+        *word |= mask;
+      } else {
+        *word &= ~mask;
+      }
+      return *this;
+    }
+
+    reference& operator=(const reference& other) {
+      return *this = bool(other);
+    }
+
+    bool operator~() const {
+      return !bool(*this);
+    }
+
+    void flip() {
+      *word ^= mask;
+    }
+
+    friend void swap(reference a, reference b) {
+      bool value = a;
+      a = bool(b);
+      b = value;
+    }
+  };
+
+  using const_reference = bool;
+
+  template <bool is_constant>
+  class Iterator {
+   private:
+    using WordsPointer = std::conditional_t<is_constant, const Words*, Words*>;
+
+    WordsPointer object_words = nullptr;
+    // bit index counted from the start of words[0]
+    size_t position = 0;
+
+   public:
+    using value_type = bool;
+    using pointer = void;
+    using reference =
+        std::conditional_t<is_constant, bool, typename Deque::reference>;
+    using difference_type = ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    Iterator(WordsPointer object_words, size_t position)
+        : object_words(object_words),
+          position(position) {
+    }
+
+    Iterator() = default;
+
+    reference operator*() const {
+      if constexpr (is_constant) {
+        return ((*object_words)[position / WORD_BITS] & Mask(position)) != 0;
+      } else {
+        return reference(&(*object_words)[position / WORD_BITS],
+                         Mask(position));
+      }
+    }
+
+    reference operator[](difference_type delta) const {
+      return *(*this + delta);
+    }
+
+    Iterator& operator++() {
+      ++position;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++position;
+      return copy;
+    }
+
+    Iterator& operator--() {
+      --position;
+      return *this;
+    }
+
+    Iterator operator--(int) {
+      Iterator copy = *this;
+      --position;
+      return copy;
+    }
+
+    Iterator& operator+=(difference_type delta) {
+      position += delta;
+      return *this;
+    }
+
+    Iterator& operator-=(difference_type delta) {
+      position -= delta;
+      return *this;
+    }
+
+    friend Iterator operator+(Iterator it, difference_type delta) {
+      return it += delta;
+    }
+
+    friend Iterator operator+(difference_type delta, Iterator it) {
+      return it += delta;
+    }
+
+    friend Iterator operator-(Iterator it, difference_type delta) {
+      return it -= delta;
+    }
+
+    difference_type operator-(const Iterator& other) const {
+      return difference_type(position) - difference_type(other.position);
+    }
+
+    bool operator==(const Iterator& it) const {
+      return position == it.position;
+    }
+    bool operator!=(const Iterator& it) const {
+      return position != it.position;
+    }
+    bool operator<(const Iterator& it) const {
+      return position < it.position;
+    }
+    bool operator<=(const Iterator& it) const {
+      return position <= it.position;
+    }
+    bool operator>(const Iterator& it) const {
+      return position > it.position;
+    }
+    bool operator>=(const Iterator& it) const {
+      return position >= it.position;
+    }
+
+    operator Iterator<true>() const {
+      return Iterator<true>(object_words, position);
+    }
+  };
+
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  Deque()
+      : Deque(Alloc()) {
+  }
+
+  explicit Deque(const Alloc& init_allocator)
+      : words(WordAlloc(init_allocator)) {
+  }
+
+  Deque(size_t new_size, const Alloc& init_allocator = Alloc())
+      : Deque(new_size, false, init_allocator) {
+  }
+
+  Deque(size_t new_size, bool value, const Alloc& init_allocator = Alloc())
+      : words((new_size + WORD_BITS - 1) / WORD_BITS,
+              value ? ~uint64_t(0) : uint64_t(0), WordAlloc(init_allocator)),
+        bit_size(new_size) {
+  }
+
+  void swap(Deque& other) {
+    words.swap(other.words);
+    std::swap(first_bit, other.first_bit);
+    std::swap(bit_size, other.bit_size);
+  }
+
+  Alloc get_allocator() const {
+    return Alloc(words.get_allocator());
+  }
+
+  size_t size() const {
+    return bit_size;
+  }
+
+  size_t capacity() const {
+    return words.capacity() * WORD_BITS;
+  }
+
+  size_t memory_bytes() const {
+    return words.memory_bytes();
+  }
+
+  void shrink_to_fit() {
+    words.shrink_to_fit();
+  }
+
+  iterator begin() {
+    return iterator(&words, first_bit);
+  }
+  iterator end() {
+    return iterator(&words, first_bit + bit_size);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(&words, first_bit);
+  }
+  const_iterator end() const {
+    return const_iterator(&words, first_bit + bit_size);
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+
+  std::reverse_iterator<iterator> rbegin() {
+    return std::reverse_iterator<iterator>(end());
+  }
+  std::reverse_iterator<iterator> rend() {
+    return std::reverse_iterator<iterator>(begin());
+  }
+
+  std::reverse_iterator<const_iterator> crbegin() const {
+    return std::reverse_iterator<const_iterator>(cend());
+  }
+  std::reverse_iterator<const_iterator> crend() const {
+    return std::reverse_iterator<const_iterator>(cbegin());
+  }
+
+  reference operator[](size_t index) {
+    size_t position = first_bit + index;
+    return reference(&words[position / WORD_BITS], Mask(position));
+  }
+
+  bool operator[](size_t index) const {
+    size_t position = first_bit + index;
+    return (words[position / WORD_BITS] & Mask(position)) != 0;
+  }
+
+  reference at(size_t index) {
+    if (index >= bit_size) {
+      throw std::out_of_range("Deque<bool>::at");
+    }
+    return (*this)[index];
+  }
+
+  bool at(size_t index) const {
+    if (index >= bit_size) {
+      throw std::out_of_range("Deque<bool>::at");
+    }
+    return (*this)[index];
+  }
+
+  void push_back(bool value) {
+    size_t position = first_bit + bit_size;
+    if (position % WORD_BITS == 0) {
+      words.push_back(0);
+    }
+    ++bit_size;
+    (*this)[bit_size - 1] = value;
+  }
+
+  void push_front(bool value) {
+    if (first_bit == 0) {
+      words.push_front(0);
+      first_bit = WORD_BITS;
+    }
+    --first_bit;
+    ++bit_size;
+    (*this)[0] = value;
+  }
+
+  void pop_back() {
+    --bit_size;
+    if ((first_bit + bit_size) % WORD_BITS == 0) {
+      words.pop_back();
+    }
+  }
+
+  void pop_front() {
+    ++first_bit;
+    --bit_size;
+    if (first_bit == WORD_BITS) {
+      words.pop_front();
+      first_bit = 0;
+    }
+  }
+
+  void flip() {
+    for (auto segment : words.segments()) {
+      for (uint64_t& word : segment) {
+        word = ~word;
+      }
+    }
+  }
+
+  // number of set elements in [first, last)
+  size_t count(size_t first, size_t last) const {
+    size_t from = first_bit + first;
+    size_t to = first_bit + last;
+    if (from >= to) {
+      return 0;
+    }
+    size_t head = from / WORD_BITS;
+    size_t tail = (to - 1) / WORD_BITS;
+    if (head == tail) {
+      return PopCount(words[head] & HeadMask(from) & TailMask(to));
+    }
+    size_t result = PopCount(words[head] & HeadMask(from)) +
+                    PopCount(words[tail] & TailMask(to));
+    for (auto segment : words.segments(words.cbegin() + (head + 1),
+                                       words.cbegin() + tail)) {
+      result += PopCount(segment.data(), segment.size());
+    }
+    return result;
+  }
+
+  size_t count() const {
+    return count(0, bit_size);
+  }
+
+  // index of the first element in [first, last) equal to 'value',
+  // 'last' if there is none
+  size_t find_first(bool value, size_t first, size_t last) const {
+    size_t from = first_bit + first;
+    size_t to = first_bit + last;
+    if (from >= to) {
+      return last;
+    }
+    uint64_t invert = value ? 0 : ~uint64_t(0);
+    size_t head = from / WORD_BITS;
+    size_t tail = (to - 1) / WORD_BITS;
+    auto found = [&](size_t index, uint64_t word) {
+      return index * WORD_BITS + size_t(__builtin_ctzll(word)) - first_bit;
+    };
+    uint64_t word = (words[head] ^ invert) & HeadMask(from);
+    if (head == tail) {
+      word &= TailMask(to);
+    }
+    if (word != 0) {
+      return found(head, word);
+    }
+    if (head == tail) {
+      return last;
+    }
+    size_t index = head + 1;
+    for (auto segment : words.segments(words.cbegin() + (head + 1),
+                                       words.cbegin() + tail)) {
+      for (uint64_t middle : segment) {
+        if ((middle ^ invert) != 0) {
+          return found(index, middle ^ invert);
+        }
+        ++index;
+      }
+    }
+    word = (words[tail] ^ invert) & TailMask(to);
+    return (word != 0) ? found(tail, word) : last;
+  }
+
+  size_t find_first(bool value) const {
+    return find_first(value, 0, bit_size);
   }
-};
\ No newline at end of file
+};
@@ -0,0 +1,728 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "deque.h"
+
+// algorithms over anything that exposes segments() (e.g. Deque):
+// each one runs the inner loop over the plain pointers of a single chunk
+// instead of stepping a Deque::iterator element by element
+namespace segmented {
+
+template <typename Container, typename Function>
+Function for_each(Container& container, Function function) {
+  for (auto segment : container.segments()) {
+    for (auto it = segment.begin(); it != segment.end(); ++it) {
+      function(*it);
+    }
+  }
+  return function;
+}
+
+template <typename Container, typename OutputIt>
+OutputIt copy(const Container& container, OutputIt out) {
+  for (auto segment : container.segments()) {
+    out = std::copy(segment.begin(), segment.end(), out);
+  }
+  return out;
+}
+
+// copies [first, last) into 'container' starting at its first element,
+// 'container' must already hold at least std::distance(first, last) elements
+template <typename InputIt, typename Container>
+InputIt copy_into(InputIt first, InputIt last, Container& container) {
+  for (auto segment : container.segments()) {
+    for (auto it = segment.begin(); it != segment.end(); ++it) {
+      if (first == last) {
+        return first;
+      }
+      *it = *first;
+      ++first;
+    }
+  }
+  return first;
+}
+
+template <typename Container, typename U>
+void fill(Container& container, const U& value) {
+  for (auto segment : container.segments()) {
+    std::fill(segment.begin(), segment.end(), value);
+  }
+}
+
+// returns iterator to the first element equal to 'value' or end()
+template <typename Container, typename U>
+auto find(Container& container, const U& value) {
+  size_t index = 0;
+  for (auto segment : container.segments()) {
+    auto it = std::find(segment.begin(), segment.end(), value);
+    if (it != segment.end()) {
+      return container.begin() + (index + (it - segment.begin()));
+    }
+    index += segment.size();
+  }
+  return container.end();
+}
+
+template <typename Container, typename Predicate>
+auto find_if(Container& container, Predicate predicate) {
+  size_t index = 0;
+  for (auto segment : container.segments()) {
+    auto it = std::find_if(segment.begin(), segment.end(), predicate);
+    if (it != segment.end()) {
+      return container.begin() + (index + (it - segment.begin()));
+    }
+    index += segment.size();
+  }
+  return container.end();
+}
+
+template <typename Container, typename U>
+U accumulate(const Container& container, U init) {
+  for (auto segment : container.segments()) {
+    init = std::accumulate(segment.begin(), segment.end(), std::move(init));
+  }
+  return init;
+}
+
+template <typename Container, typename U, typename BinaryOperation>
+U accumulate(const Container& container, U init, BinaryOperation operation) {
+  for (auto segment : container.segments()) {
+    init = std::accumulate(segment.begin(), segment.end(), std::move(init),
+                           operation);
+  }
+  return init;
+}
+
+namespace detail {
+
+// below this many elements per thread the parallel algorithms stop splitting
+constexpr size_t PARALLEL_GRAIN = size_t(1) << 14;
+
+// runs 'function(task)' for every task in [0, tasks) on up to 'threads'
+// threads (the calling one included) and rethrows the first exception
+template <typename Function>
+void RunParallel(size_t tasks, size_t threads, Function function) {
+  std::atomic<size_t> next{0};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto work = [&] {
+    for (size_t task = next++; task < tasks; task = next++) {
+      try {
+        function(task);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  try {
+    for (size_t i = 1; i < std::min(threads, tasks); ++i) {
+      workers.emplace_back(work);
+    }
+  } catch (...) {
+    // fewer threads than asked for, the calling thread does the rest
+  }
+  work();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+inline size_t PieceSize(size_t count, size_t threads) {
+  return std::max(PARALLEL_GRAIN, (count + threads - 1) / threads);
+}
+
+// walks the elements of a Spans from some position on; stepping past the
+// last element is allowed, dereferencing there is not
+template <typename T>
+class SpanCursor {
+ public:
+  SpanCursor(T* const* firsts, const size_t* starts, size_t spans,
+             size_t span, size_t offset)
+      : firsts(firsts),
+        starts(starts),
+        spans(spans),
+        span(span),
+        current(firsts[span] + offset),
+        end(firsts[span] + (starts[span + 1] - starts[span])) {
+  }
+
+  T& operator*() const {
+    return *current;
+  }
+
+  SpanCursor& operator++() {
+    if (++current == end && span + 1 < spans) {
+      ++span;
+      current = firsts[span];
+      end = current + (starts[span + 1] - starts[span]);
+    }
+    return *this;
+  }
+
+ private:
+  T* const* firsts;
+  const size_t* starts;
+  size_t spans;
+  size_t span;
+  T* current;
+  T* end;
+};
+
+// the chunks of a container, collected once on the calling thread: the
+// non-const segments() may unshare chunks, so worker threads must only
+// ever see these plain pointers, never the container itself
+template <typename T>
+class Spans {
+ public:
+  template <typename Container>
+  explicit Spans(Container& container) {
+    starts.push_back(0);
+    for (auto segment : container.segments()) {
+      if (segment.size() != 0) {
+        firsts.push_back(segment.begin());
+        starts.push_back(starts.back() + segment.size());
+      }
+    }
+  }
+
+  size_t size() const {
+    return starts.back();
+  }
+
+  T& operator[](size_t index) const {
+    size_t span = Find(index);
+    return firsts[span][index - starts[span]];
+  }
+
+  SpanCursor<T> At(size_t index) const {
+    size_t span = Find(index);
+    return SpanCursor<T>(firsts.data(), starts.data(), firsts.size(), span,
+                         index - starts[span]);
+  }
+
+  // calls 'function(first, last)' for the contiguous parts of
+  // elements [first, last), in order
+  template <typename Function>
+  void ForEach(size_t first, size_t last, Function function) const {
+    for (size_t span = Find(first); first < last; ++span) {
+      size_t span_last = std::min(last, starts[span + 1]);
+      function(firsts[span] + (first - starts[span]),
+               firsts[span] + (span_last - starts[span]));
+      first = span_last;
+    }
+  }
+
+ private:
+  std::vector<T*> firsts;
+  // starts[i] is the index of the first element of span i,
+  // starts.back() the number of elements
+  std::vector<size_t> starts;
+
+  size_t Find(size_t index) const {
+    if (index >= size()) {
+      return firsts.empty() ? 0 : firsts.size() - 1;
+    }
+    return std::upper_bound(starts.begin(), starts.end(), index) -
+           starts.begin() - 1;
+  }
+};
+
+// a plain buffer and a Spans are accessed alike: buffer[index] and
+// At(buffer, index), a cursor that steps through the following elements
+template <typename T>
+T* At(T* buffer, size_t index) {
+  return buffer + index;
+}
+
+template <typename T>
+SpanCursor<T> At(const Spans<T>& spans, size_t index) {
+  return spans.At(index);
+}
+
+// moves 'in[first, last)' to elements [first, last) of 'spans'
+template <typename T>
+void MoveBack(T* in, const Spans<T>& spans, size_t first, size_t last,
+              size_t threads) {
+  size_t piece = PieceSize(last - first, threads);
+  RunParallel((last - first + piece - 1) / piece, threads, [&](size_t task) {
+    size_t piece_first = first + task * piece;
+    T* from = in + piece_first;
+    spans.ForEach(piece_first, std::min(piece_first + piece, last),
+                  [&](T* span_first, T* span_last) {
+                    std::move(from, from + (span_last - span_first),
+                              span_first);
+                    from += span_last - span_first;
+                  });
+  });
+}
+
+// uninitialized storage with room for all elements of a container, taken
+// from the container's allocator; Fill moves a range of them in, Clear
+// destroys it again, so at most one range [first, last) is alive in the
+// buffer at a time
+template <typename T, typename Alloc>
+class Scratch {
+  using Allocator =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using Traits = std::allocator_traits<Allocator>;
+
+ public:
+  Scratch(const Alloc& init_alloc, size_t capacity)
+      : alloc(init_alloc),
+        capacity(capacity) {
+    data = Traits::allocate(alloc, capacity);
+  }
+
+  Scratch(const Scratch&) = delete;
+  Scratch& operator=(const Scratch&) = delete;
+
+  ~Scratch() {
+    Clear();
+    Traits::deallocate(alloc, data, capacity);
+  }
+
+  T* data;
+
+  // moves elements [first, last) of 'spans' into data[first, last),
+  // 'pieces' equal pieces of it in parallel; if a move throws, the
+  // elements moved so far are moved back and nothing stays constructed
+  // in the buffer
+  void Fill(const Spans<T>& spans, size_t first, size_t last, size_t pieces,
+            size_t threads) {
+    auto piece_begin = [&](size_t piece) {
+      return first + (last - first) * piece / pieces;
+    };
+    std::vector<char> filled(pieces, false);
+    try {
+      RunParallel(pieces, threads, [&](size_t piece) {
+        T* out = data + piece_begin(piece);
+        try {
+          spans.ForEach(piece_begin(piece), piece_begin(piece + 1),
+                        [&](T* span_first, T* span_last) {
+                          for (; span_first != span_last; ++span_first) {
+                            Traits::construct(alloc, out,
+                                              std::move(*span_first));
+                            ++out;
+                          }
+                        });
+        } catch (...) {
+          Restore(spans, piece_begin(piece), out - data);
+          throw;
+        }
+        filled[piece] = true;
+      });
+    } catch (...) {
+      for (size_t piece = 0; piece < pieces; ++piece) {
+        if (filled[piece]) {
+          Restore(spans, piece_begin(piece), piece_begin(piece + 1));
+        }
+      }
+      throw;
+    }
+    alive_first = first;
+    alive_last = last;
+  }
+
+  void Fill(const Spans<T>& spans, size_t first, size_t last,
+            size_t threads) {
+    size_t piece = PieceSize(last - first, threads);
+    Fill(spans, first, last, (last - first + piece - 1) / piece, threads);
+  }
+
+  void Clear() {
+    Destroy(alive_first, alive_last);
+    alive_first = alive_last = 0;
+  }
+
+ private:
+  Allocator alloc;
+  size_t capacity;
+  size_t alive_first = 0;
+  size_t alive_last = 0;
+
+  void Destroy(size_t first, size_t last) {
+    for (; first != last; ++first) {
+      Traits::destroy(alloc, data + first);
+    }
+  }
+
+  // moves data[first, last) back to 'spans' and destroys it
+  void Restore(const Spans<T>& spans, size_t first, size_t last) {
+    MoveBack(data, spans, first, last, 1);
+    Destroy(first, last);
+  }
+};
+
+// runs 'function' while the elements [first, last) are in 'buffer': if it
+// throws they are moved back to 'spans' before the exception goes on
+template <typename T, typename Function>
+void InBuffer(T* buffer, const Spans<T>& spans, size_t first, size_t last,
+              size_t threads, Function function) {
+  try {
+    function();
+  } catch (...) {
+    MoveBack(buffer, spans, first, last, threads);
+    throw;
+  }
+}
+
+// how many of the first 'output' merged elements of the runs
+// source[left, middle) and source[middle, right) come from the left one
+// (ties go to the left one)
+template <typename Source, typename Compare>
+size_t MergeSplit(const Source& source, size_t left, size_t middle,
+                  size_t right, size_t output, Compare& compare) {
+  size_t right_size = right - middle;
+  size_t low = (output > right_size) ? output - right_size : 0;
+  size_t high = std::min(output, middle - left);
+  while (low < high) {
+    size_t split = low + (high - low) / 2;
+    if (compare(source[middle + (output - split - 1)], source[left + split])) {
+      high = split;
+    } else {
+      low = split + 1;
+    }
+  }
+  return low;
+}
+
+// writes merged elements [first, last) of the sorted runs source[left,
+// middle) and source[middle, ...) to target[left + first, left + last),
+// given 'left_first' and 'left_last', MergeSplit at 'first' and 'last';
+// source and target are a buffer and a Spans of the same size, either
+// way round; if 'compare' throws, the rest of the piece is still moved,
+// unmerged, so every element ends up in 'target'
+template <typename Source, typename Target, typename Compare>
+void MergePiece(const Source& source, size_t left, size_t middle,
+                size_t first, size_t last, size_t left_first,
+                size_t left_last, const Target& target, Compare& compare) {
+  size_t left_count = left_last - left_first;
+  size_t right_count = (last - first) - left_count;
+  auto left_it = At(source, left + left_first);
+  auto right_it = At(source, middle + (first - left_first));
+  auto out = At(target, left + first);
+  auto flush = [&] {
+    for (; left_count != 0; --left_count, ++left_it, ++out) {
+      *out = std::move(*left_it);
+    }
+    for (; right_count != 0; --right_count, ++right_it, ++out) {
+      *out = std::move(*right_it);
+    }
+  };
+  try {
+    while (left_count != 0 && right_count != 0) {
+      if (compare(*right_it, *left_it)) {
+        *out = std::move(*right_it);
+        ++right_it;
+        --right_count;
+      } else {
+        *out = std::move(*left_it);
+        ++left_it;
+        --left_count;
+      }
+      ++out;
+    }
+  } catch (...) {
+    flush();
+    throw;
+  }
+  flush();
+}
+
+// stable distribution of 'in[first, last)' into CLASSES groups laid out one
+// after another in elements [first, last) of 'spans', 'classify(x)' picks
+// the group; returns the size of every group; if 'classify' throws, every
+// element is still moved to 'spans', in no particular order
+template <size_t CLASSES, typename T, typename Classify>
+std::array<size_t, CLASSES> Distribute(T* in, const Spans<T>& spans,
+                                       size_t first, size_t last,
+                                       Classify classify, size_t threads) {
+  size_t count = last - first;
+  size_t blocks = std::max<size_t>(
+      1, std::min(threads, count / PARALLEL_GRAIN));
+  auto block_begin = [&](size_t block) {
+    return first + count * block / blocks;
+  };
+  std::vector<std::array<size_t, CLASSES>> starts(blocks);
+  InBuffer(in, spans, first, last, threads, [&] {
+    RunParallel(blocks, threads, [&](size_t block) {
+      starts[block].fill(0);
+      for (size_t i = block_begin(block); i < block_begin(block + 1); ++i) {
+        ++starts[block][classify(in[i])];
+      }
+    });
+  });
+  std::vector<std::array<size_t, CLASSES>> room = starts;
+  std::array<size_t, CLASSES> sizes{};
+  size_t offset = first;
+  for (size_t group = 0; group < CLASSES; ++group) {
+    for (size_t block = 0; block < blocks; ++block) {
+      size_t block_count = starts[block][group];
+      starts[block][group] = offset;
+      offset += block_count;
+      sizes[group] += block_count;
+    }
+  }
+  RunParallel(blocks, threads, [&](size_t block) {
+    // every group of a block is written to one run of consecutive elements
+    std::vector<SpanCursor<T>> outs;
+    for (size_t group = 0; group < CLASSES; ++group) {
+      outs.push_back(spans.At(starts[block][group]));
+    }
+    std::array<size_t, CLASSES>& left = room[block];
+    size_t i = block_begin(block);
+    try {
+      for (; i < block_begin(block + 1); ++i) {
+        size_t group = classify(in[i]);
+        *outs[group] = std::move(in[i]);
+        ++outs[group];
+        --left[group];
+      }
+    } catch (...) {
+      // the rest of the block goes to the rest of its places
+      for (size_t group = 0; group < CLASSES; ++group) {
+        for (; left[group] != 0; --left[group], ++i) {
+          *outs[group] = std::move(in[i]);
+          ++outs[group];
+        }
+      }
+      throw;
+    }
+  });
+  return sizes;
+}
+
+}  // namespace detail
+
+// the algorithms below move the elements into one uninitialized buffer the
+// size of the container, taken from its allocator, work on it with up to
+// 'parallel.threads' threads and move the result back chunk by chunk; the
+// chunks are collected once on the calling thread beforehand
+//
+// if 'compare' or 'predicate' throws, the elements are moved back into the
+// container in an unspecified order; only the std::sort or std::nth_element
+// run on a part of the buffer may lose the one element it holds aside, as
+// on any other container; if a move throws, the elements are left in a
+// valid but unspecified state
+
+// sorts 'parallel.threads' parts separately in the buffer, then merges
+// parts pairwise back and forth between the buffer and the chunks,
+// every merge split into independent pieces by binary search
+template <typename Container, typename Compare>
+void sort(Container& container, Compare compare, DequeParallel parallel) {
+  using T = typename Container::value_type;
+  using Alloc = typename Container::allocator_type;
+  detail::Spans<T> spans(container);
+  size_t count = spans.size();
+  if (count < 2) {
+    return;
+  }
+  size_t threads = std::max<size_t>(1, parallel.threads);
+  size_t runs = std::max<size_t>(
+      1, std::min(threads, count / detail::PARALLEL_GRAIN));
+  std::vector<size_t> bounds(runs + 1);
+  for (size_t run = 0; run <= runs; ++run) {
+    bounds[run] = count * run / runs;
+  }
+
+  detail::Scratch<T, Alloc> scratch(container.get_allocator(), count);
+  T* buffer = scratch.data;
+  scratch.Fill(spans, 0, count, runs, threads);
+  detail::InBuffer(buffer, spans, 0, count, threads, [&] {
+    detail::RunParallel(runs, threads, [&](size_t run) {
+      std::sort(buffer + bounds[run], buffer + bounds[run + 1], compare);
+    });
+  });
+
+  bool in_buffer = true;
+  size_t piece = detail::PieceSize(count, threads);
+  // a task merges output [first, last) of the runs [left, middle) and
+  // [middle, right), the offsets are relative to 'left'
+  struct Task {
+    size_t left;
+    size_t middle;
+    size_t right;
+    size_t first;
+    size_t last;
+    size_t left_first;
+    size_t left_last;
+  };
+  std::vector<Task> tasks;
+  // every split is found before any piece starts to move elements away
+  // from under the binary searches of the others; if 'compare' throws, the
+  // elements are in the source after a split and in the target after a
+  // merge, and are moved back from the buffer
+  auto merge = [&](const auto& source, const auto& target) {
+    detail::InBuffer(buffer, spans, 0, in_buffer ? count : 0, threads, [&] {
+      detail::RunParallel(tasks.size(), threads, [&](size_t index) {
+        Task& task = tasks[index];
+        task.left_first = detail::MergeSplit(
+            source, task.left, task.middle, task.right, task.first, compare);
+        task.left_last = detail::MergeSplit(
+            source, task.left, task.middle, task.right, task.last, compare);
+      });
+    });
+    detail::InBuffer(buffer, spans, 0, in_buffer ? 0 : count, threads, [&] {
+      detail::RunParallel(tasks.size(), threads, [&](size_t index) {
+        const Task& task = tasks[index];
+        detail::MergePiece(source, task.left, task.middle, task.first,
+                           task.last, task.left_first, task.left_last, target,
+                           compare);
+      });
+    });
+  };
+  while (bounds.size() > 2) {
+    std::vector<size_t> merged_bounds;
+    tasks.clear();
+    for (size_t pair = 0; pair + 1 < bounds.size(); pair += 2) {
+      size_t left = bounds[pair];
+      size_t middle = bounds[std::min(pair + 1, bounds.size() - 1)];
+      size_t right = bounds[std::min(pair + 2, bounds.size() - 1)];
+      merged_bounds.push_back(left);
+      for (size_t first = left; first < right; first += piece) {
+        tasks.push_back({left, middle, right, first - left,
+                         std::min(first + piece, right) - left, 0, 0});
+      }
+    }
+    merged_bounds.push_back(count);
+    if (in_buffer) {
+      merge(buffer, spans);
+    } else {
+      merge(spans, buffer);
+    }
+    in_buffer = !in_buffer;
+    bounds.swap(merged_bounds);
+  }
+  if (in_buffer) {
+    detail::MoveBack(buffer, spans, 0, count, threads);
+  }
+}
+
+template <typename Container, typename Compare>
+void sort(Container& container, Compare compare) {
+  segmented::sort(container, compare, DequeParallel());
+}
+
+template <typename Container>
+void sort(Container& container) {
+  segmented::sort(container, std::less<>(), DequeParallel());
+}
+
+// stable: returns iterator to the first element for which
+// 'predicate' is false
+template <typename Container, typename Predicate>
+auto partition(Container& container, Predicate predicate,
+               DequeParallel parallel) {
+  using T = typename Container::value_type;
+  using Alloc = typename Container::allocator_type;
+  detail::Spans<T> spans(container);
+  size_t count = spans.size();
+  if (count == 0) {
+    return container.begin();
+  }
+  size_t threads = std::max<size_t>(1, parallel.threads);
+  detail::Scratch<T, Alloc> scratch(container.get_allocator(), count);
+  scratch.Fill(spans, 0, count, threads);
+  auto sizes = detail::Distribute<2>(
+      scratch.data, spans, 0, count,
+      [&](const T& value) { return predicate(value) ? 0 : 1; }, threads);
+  return container.begin() + sizes[0];
+}
+
+template <typename Container, typename Predicate>
+auto partition(Container& container, Predicate predicate) {
+  return segmented::partition(container, predicate, DequeParallel());
+}
+
+// puts the element that sorting would place at 'index' there, with no
+// greater element before and no smaller one after it;
+// quickselect with parallel three-way partitioning while the range is big:
+// every round moves the range into the buffer and distributes it back,
+// the part around 'index' is searched next
+template <typename Container, typename Compare>
+void nth_element(Container& container, size_t index, Compare compare,
+                 DequeParallel parallel) {
+  using T = typename Container::value_type;
+  using Alloc = typename Container::allocator_type;
+  detail::Spans<T> spans(container);
+  size_t count = spans.size();
+  if (index >= count) {
+    return;
+  }
+  size_t threads = std::max<size_t>(1, parallel.threads);
+  detail::Scratch<T, Alloc> scratch(container.get_allocator(), count);
+  T* buffer = scratch.data;
+
+  size_t first = 0;
+  size_t last = count;
+  // bad pivots fall back to std::nth_element instead of going quadratic
+  size_t rounds = 64;
+  while (threads > 1 && last - first > detail::PARALLEL_GRAIN &&
+         rounds-- > 0) {
+    scratch.Fill(spans, first, last, threads);
+    size_t middle = first + (last - first) / 2;
+    const T* candidates[] = {buffer + first, buffer + middle,
+                             buffer + last - 1};
+    // a copy: the buffer is moved from while the pivot is still in use
+    std::optional<T> pivot;
+    detail::InBuffer(buffer, spans, first, last, threads, [&] {
+      std::sort(std::begin(candidates), std::end(candidates),
+                [&](const T* a, const T* b) { return compare(*a, *b); });
+      pivot.emplace(*candidates[1]);
+    });
+    auto sizes = detail::Distribute<3>(
+        buffer, spans, first, last,
+        [&](const T& value) {
+          return compare(value, *pivot) ? 0
+                                        : (compare(*pivot, value) ? 2 : 1);
+        },
+        threads);
+    scratch.Clear();
+    size_t less_end = first + sizes[0];
+    size_t equal_end = less_end + sizes[1];
+    if (index < less_end) {
+      last = less_end;
+    } else if (index < equal_end) {
+      return;
+    } else {
+      first = equal_end;
+    }
+  }
+  scratch.Fill(spans, first, last, threads);
+  detail::InBuffer(buffer, spans, first, last, threads, [&] {
+    std::nth_element(buffer + first, buffer + index, buffer + last, compare);
+  });
+  detail::MoveBack(buffer, spans, first, last, threads);
+}
+
+template <typename Container, typename Compare>
+void nth_element(Container& container, size_t index, Compare compare) {
+  segmented::nth_element(container, index, compare, DequeParallel());
+}
+
+template <typename Container>
+void nth_element(Container& container, size_t index) {
+  segmented::nth_element(container, index, std::less<>(), DequeParallel());
+}
+
+}  // namespace segmented
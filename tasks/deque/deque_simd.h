@@ -0,0 +1,641 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "deque.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define DEQUE_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define DEQUE_SIMD_X86 0
+#endif
+
+// vectorized reductions and searches over numeric containers with
+// segments() (e.g. Deque<float>, Deque<int64_t>): every chunk is scanned
+// with the widest instruction set the CPU supports, picked once at runtime;
+// element types without a dedicated kernel use the scalar loop
+namespace simd {
+
+enum class Isa { SCALAR, SSE, AVX2 };
+
+namespace detail {
+
+inline Isa DetectIsa() {
+#if DEQUE_SIMD_X86
+  // every feature the kernels of a level are compiled for must be there
+  __builtin_cpu_init();
+  bool popcnt = __builtin_cpu_supports("popcnt");
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+      popcnt) {
+    return Isa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2") && popcnt) {
+    return Isa::SSE;
+  }
+#endif
+  return Isa::SCALAR;
+}
+
+template <typename U>
+U MinIdentity() {
+  if constexpr (std::numeric_limits<U>::has_infinity) {
+    return std::numeric_limits<U>::infinity();
+  }
+  return std::numeric_limits<U>::max();
+}
+
+template <typename U>
+U MaxIdentity() {
+  if constexpr (std::numeric_limits<U>::has_infinity) {
+    return -std::numeric_limits<U>::infinity();
+  }
+  return std::numeric_limits<U>::lowest();
+}
+
+namespace scalar {
+
+template <typename U>
+U Sum(const U* first, const U* last) {
+  U result = U();
+  for (; first != last; ++first) {
+    result += *first;
+  }
+  return result;
+}
+
+template <typename U>
+U Min(const U* first, const U* last) {
+  U result = MinIdentity<U>();
+  for (; first != last; ++first) {
+    result = (*first < result) ? *first : result;
+  }
+  return result;
+}
+
+template <typename U>
+U Max(const U* first, const U* last) {
+  U result = MaxIdentity<U>();
+  for (; first != last; ++first) {
+    result = (result < *first) ? *first : result;
+  }
+  return result;
+}
+
+template <typename U>
+size_t CountGreater(const U* first, const U* last, U threshold) {
+  size_t result = 0;
+  for (; first != last; ++first) {
+    result += (threshold < *first) ? 1 : 0;
+  }
+  return result;
+}
+
+template <typename U>
+const U* FindGreater(const U* first, const U* last, U threshold) {
+  for (; first != last; ++first) {
+    if (threshold < *first) {
+      return first;
+    }
+  }
+  return last;
+}
+
+template <typename U>
+const U* Find(const U* first, const U* last, U value) {
+  for (; first != last; ++first) {
+    if (*first == value) {
+      return first;
+    }
+  }
+  return last;
+}
+
+}  // namespace scalar
+
+#if DEQUE_SIMD_X86
+
+namespace avx2 {
+
+__attribute__((target("avx2"))) inline float HorizontalSum(__m256 value) {
+  __m128 low = _mm256_castps256_ps128(value);
+  __m128 high = _mm256_extractf128_ps(value, 1);
+  low = _mm_add_ps(low, high);
+  low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+  low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 1));
+  return _mm_cvtss_f32(low);
+}
+
+__attribute__((target("avx2"))) inline float Sum(const float* first,
+                                                 const float* last) {
+  __m256 accumulator = _mm256_setzero_ps();
+  for (; last - first >= 8; first += 8) {
+    accumulator = _mm256_add_ps(accumulator, _mm256_loadu_ps(first));
+  }
+  return HorizontalSum(accumulator) + scalar::Sum(first, last);
+}
+
+__attribute__((target("avx2"))) inline float Min(const float* first,
+                                                 const float* last) {
+  __m256 accumulator = _mm256_set1_ps(MinIdentity<float>());
+  for (; last - first >= 8; first += 8) {
+    accumulator = _mm256_min_ps(accumulator, _mm256_loadu_ps(first));
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, accumulator);
+  float result = scalar::Min(lanes, lanes + 8);
+  float tail = scalar::Min(first, last);
+  return (tail < result) ? tail : result;
+}
+
+__attribute__((target("avx2"))) inline float Max(const float* first,
+                                                 const float* last) {
+  __m256 accumulator = _mm256_set1_ps(MaxIdentity<float>());
+  for (; last - first >= 8; first += 8) {
+    accumulator = _mm256_max_ps(accumulator, _mm256_loadu_ps(first));
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, accumulator);
+  float result = scalar::Max(lanes, lanes + 8);
+  float tail = scalar::Max(first, last);
+  return (result < tail) ? tail : result;
+}
+
+__attribute__((target("avx2,popcnt"))) inline size_t CountGreater(
+    const float* first, const float* last, float threshold) {
+  __m256 bound = _mm256_set1_ps(threshold);
+  size_t result = 0;
+  for (; last - first >= 8; first += 8) {
+    __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(first), bound, _CMP_GT_OQ);
+    result += _mm_popcnt_u32(_mm256_movemask_ps(mask));
+  }
+  return result + scalar::CountGreater(first, last, threshold);
+}
+
+__attribute__((target("avx2,bmi"))) inline const float* FindGreater(
+    const float* first, const float* last, float threshold) {
+  __m256 bound = _mm256_set1_ps(threshold);
+  for (; last - first >= 8; first += 8) {
+    __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(first), bound, _CMP_GT_OQ);
+    int bits = _mm256_movemask_ps(mask);
+    if (bits != 0) {
+      return first + _tzcnt_u32(bits);
+    }
+  }
+  return scalar::FindGreater(first, last, threshold);
+}
+
+__attribute__((target("avx2,bmi"))) inline const float* Find(
+    const float* first, const float* last, float value) {
+  __m256 needle = _mm256_set1_ps(value);
+  for (; last - first >= 8; first += 8) {
+    __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(first), needle, _CMP_EQ_OQ);
+    int bits = _mm256_movemask_ps(mask);
+    if (bits != 0) {
+      return first + _tzcnt_u32(bits);
+    }
+  }
+  return scalar::Find(first, last, value);
+}
+
+__attribute__((target("avx2"))) inline int64_t Sum(const int64_t* first,
+                                                   const int64_t* last) {
+  __m256i accumulator = _mm256_setzero_si256();
+  for (; last - first >= 4; first += 4) {
+    accumulator = _mm256_add_epi64(
+        accumulator,
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first)));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+  return scalar::Sum(lanes, lanes + 4) + scalar::Sum(first, last);
+}
+
+__attribute__((target("avx2"))) inline int64_t Min(const int64_t* first,
+                                                   const int64_t* last) {
+  __m256i accumulator = _mm256_set1_epi64x(MinIdentity<int64_t>());
+  for (; last - first >= 4; first += 4) {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i greater = _mm256_cmpgt_epi64(accumulator, value);
+    accumulator = _mm256_blendv_epi8(accumulator, value, greater);
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+  int64_t result = scalar::Min(lanes, lanes + 4);
+  int64_t tail = scalar::Min(first, last);
+  return (tail < result) ? tail : result;
+}
+
+__attribute__((target("avx2"))) inline int64_t Max(const int64_t* first,
+                                                   const int64_t* last) {
+  __m256i accumulator = _mm256_set1_epi64x(MaxIdentity<int64_t>());
+  for (; last - first >= 4; first += 4) {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i greater = _mm256_cmpgt_epi64(value, accumulator);
+    accumulator = _mm256_blendv_epi8(accumulator, value, greater);
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), accumulator);
+  int64_t result = scalar::Max(lanes, lanes + 4);
+  int64_t tail = scalar::Max(first, last);
+  return (result < tail) ? tail : result;
+}
+
+__attribute__((target("avx2,popcnt"))) inline size_t CountGreater(
+    const int64_t* first, const int64_t* last, int64_t threshold) {
+  __m256i bound = _mm256_set1_epi64x(threshold);
+  size_t result = 0;
+  for (; last - first >= 4; first += 4) {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i mask = _mm256_cmpgt_epi64(value, bound);
+    result += _mm_popcnt_u32(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+  }
+  return result + scalar::CountGreater(first, last, threshold);
+}
+
+__attribute__((target("avx2,bmi"))) inline const int64_t* FindGreater(
+    const int64_t* first, const int64_t* last, int64_t threshold) {
+  __m256i bound = _mm256_set1_epi64x(threshold);
+  for (; last - first >= 4; first += 4) {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i mask = _mm256_cmpgt_epi64(value, bound);
+    int bits = _mm256_movemask_pd(_mm256_castsi256_pd(mask));
+    if (bits != 0) {
+      return first + _tzcnt_u32(bits);
+    }
+  }
+  return scalar::FindGreater(first, last, threshold);
+}
+
+__attribute__((target("avx2,bmi"))) inline const int64_t* Find(
+    const int64_t* first, const int64_t* last, int64_t needle_value) {
+  __m256i needle = _mm256_set1_epi64x(needle_value);
+  for (; last - first >= 4; first += 4) {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    __m256i mask = _mm256_cmpeq_epi64(value, needle);
+    int bits = _mm256_movemask_pd(_mm256_castsi256_pd(mask));
+    if (bits != 0) {
+      return first + _tzcnt_u32(bits);
+    }
+  }
+  return scalar::Find(first, last, needle_value);
+}
+
+}  // namespace avx2
+
+namespace sse {
+
+__attribute__((target("sse4.2"))) inline float Sum(const float* first,
+                                                   const float* last) {
+  __m128 accumulator = _mm_setzero_ps();
+  for (; last - first >= 4; first += 4) {
+    accumulator = _mm_add_ps(accumulator, _mm_loadu_ps(first));
+  }
+  accumulator =
+      _mm_add_ps(accumulator, _mm_movehl_ps(accumulator, accumulator));
+  accumulator =
+      _mm_add_ss(accumulator, _mm_shuffle_ps(accumulator, accumulator, 1));
+  return _mm_cvtss_f32(accumulator) + scalar::Sum(first, last);
+}
+
+__attribute__((target("sse4.2"))) inline float Min(const float* first,
+                                                   const float* last) {
+  __m128 accumulator = _mm_set1_ps(MinIdentity<float>());
+  for (; last - first >= 4; first += 4) {
+    accumulator = _mm_min_ps(accumulator, _mm_loadu_ps(first));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, accumulator);
+  float result = scalar::Min(lanes, lanes + 4);
+  float tail = scalar::Min(first, last);
+  return (tail < result) ? tail : result;
+}
+
+__attribute__((target("sse4.2"))) inline float Max(const float* first,
+                                                   const float* last) {
+  __m128 accumulator = _mm_set1_ps(MaxIdentity<float>());
+  for (; last - first >= 4; first += 4) {
+    accumulator = _mm_max_ps(accumulator, _mm_loadu_ps(first));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, accumulator);
+  float result = scalar::Max(lanes, lanes + 4);
+  float tail = scalar::Max(first, last);
+  return (result < tail) ? tail : result;
+}
+
+__attribute__((target("sse4.2,popcnt"))) inline size_t CountGreater(
+    const float* first, const float* last, float threshold) {
+  __m128 bound = _mm_set1_ps(threshold);
+  size_t result = 0;
+  for (; last - first >= 4; first += 4) {
+    __m128 mask = _mm_cmpgt_ps(_mm_loadu_ps(first), bound);
+    result += _mm_popcnt_u32(_mm_movemask_ps(mask));
+  }
+  return result + scalar::CountGreater(first, last, threshold);
+}
+
+__attribute__((target("sse4.2"))) inline const float* FindGreater(
+    const float* first, const float* last, float threshold) {
+  __m128 bound = _mm_set1_ps(threshold);
+  for (; last - first >= 4; first += 4) {
+    int bits = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(first), bound));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits);
+    }
+  }
+  return scalar::FindGreater(first, last, threshold);
+}
+
+__attribute__((target("sse4.2"))) inline const float* Find(const float* first,
+                                                           const float* last,
+                                                           float value) {
+  __m128 needle = _mm_set1_ps(value);
+  for (; last - first >= 4; first += 4) {
+    int bits = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(first), needle));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits);
+    }
+  }
+  return scalar::Find(first, last, value);
+}
+
+__attribute__((target("sse4.2"))) inline int64_t Sum(const int64_t* first,
+                                                     const int64_t* last) {
+  __m128i accumulator = _mm_setzero_si128();
+  for (; last - first >= 2; first += 2) {
+    accumulator = _mm_add_epi64(
+        accumulator, _mm_loadu_si128(reinterpret_cast<const __m128i*>(first)));
+  }
+  alignas(16) int64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+  return lanes[0] + lanes[1] + scalar::Sum(first, last);
+}
+
+__attribute__((target("sse4.2"))) inline int64_t Min(const int64_t* first,
+                                                     const int64_t* last) {
+  __m128i accumulator = _mm_set1_epi64x(MinIdentity<int64_t>());
+  for (; last - first >= 2; first += 2) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i greater = _mm_cmpgt_epi64(accumulator, value);
+    accumulator = _mm_blendv_epi8(accumulator, value, greater);
+  }
+  alignas(16) int64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+  int64_t result = scalar::Min(lanes, lanes + 2);
+  int64_t tail = scalar::Min(first, last);
+  return (tail < result) ? tail : result;
+}
+
+__attribute__((target("sse4.2"))) inline int64_t Max(const int64_t* first,
+                                                     const int64_t* last) {
+  __m128i accumulator = _mm_set1_epi64x(MaxIdentity<int64_t>());
+  for (; last - first >= 2; first += 2) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i greater = _mm_cmpgt_epi64(value, accumulator);
+    accumulator = _mm_blendv_epi8(accumulator, value, greater);
+  }
+  alignas(16) int64_t lanes[2];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), accumulator);
+  int64_t result = scalar::Max(lanes, lanes + 2);
+  int64_t tail = scalar::Max(first, last);
+  return (result < tail) ? tail : result;
+}
+
+__attribute__((target("sse4.2,popcnt"))) inline size_t CountGreater(
+    const int64_t* first, const int64_t* last, int64_t threshold) {
+  __m128i bound = _mm_set1_epi64x(threshold);
+  size_t result = 0;
+  for (; last - first >= 2; first += 2) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128i mask = _mm_cmpgt_epi64(value, bound);
+    result += _mm_popcnt_u32(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+  }
+  return result + scalar::CountGreater(first, last, threshold);
+}
+
+__attribute__((target("sse4.2"))) inline const int64_t* FindGreater(
+    const int64_t* first, const int64_t* last, int64_t threshold) {
+  __m128i bound = _mm_set1_epi64x(threshold);
+  for (; last - first >= 2; first += 2) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    int bits = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(value, bound)));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits);
+    }
+  }
+  return scalar::FindGreater(first, last, threshold);
+}
+
+__attribute__((target("sse4.2"))) inline const int64_t* Find(
+    const int64_t* first, const int64_t* last, int64_t needle_value) {
+  __m128i needle = _mm_set1_epi64x(needle_value);
+  for (; last - first >= 2; first += 2) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    int bits =
+        _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(value, needle)));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits);
+    }
+  }
+  return scalar::Find(first, last, needle_value);
+}
+
+}  // namespace sse
+
+#endif
+
+template <typename U>
+constexpr bool HasKernel() {
+  return std::is_same_v<U, float> || std::is_same_v<U, int64_t>;
+}
+
+// dispatchers: types without a vector kernel always take the scalar loop
+template <typename U>
+U Sum(Isa isa, const U* first, const U* last) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::Sum(first, last);
+    }
+    if (isa == Isa::SSE) {
+      return sse::Sum(first, last);
+    }
+  }
+#endif
+  return scalar::Sum(first, last);
+}
+
+template <typename U>
+U Min(Isa isa, const U* first, const U* last) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::Min(first, last);
+    }
+    if (isa == Isa::SSE) {
+      return sse::Min(first, last);
+    }
+  }
+#endif
+  return scalar::Min(first, last);
+}
+
+template <typename U>
+U Max(Isa isa, const U* first, const U* last) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::Max(first, last);
+    }
+    if (isa == Isa::SSE) {
+      return sse::Max(first, last);
+    }
+  }
+#endif
+  return scalar::Max(first, last);
+}
+
+template <typename U>
+size_t CountGreater(Isa isa, const U* first, const U* last, U threshold) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::CountGreater(first, last, threshold);
+    }
+    if (isa == Isa::SSE) {
+      return sse::CountGreater(first, last, threshold);
+    }
+  }
+#endif
+  return scalar::CountGreater(first, last, threshold);
+}
+
+template <typename U>
+const U* FindGreater(Isa isa, const U* first, const U* last, U threshold) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::FindGreater(first, last, threshold);
+    }
+    if (isa == Isa::SSE) {
+      return sse::FindGreater(first, last, threshold);
+    }
+  }
+#endif
+  return scalar::FindGreater(first, last, threshold);
+}
+
+template <typename U>
+const U* Find(Isa isa, const U* first, const U* last, U value) {
+#if DEQUE_SIMD_X86
+  if constexpr (HasKernel<U>()) {
+    if (isa == Isa::AVX2) {
+      return avx2::Find(first, last, value);
+    }
+    if (isa == Isa::SSE) {
+      return sse::Find(first, last, value);
+    }
+  }
+#endif
+  return scalar::Find(first, last, value);
+}
+
+}  // namespace detail
+
+// instruction set used by the functions below, detected on first call
+inline Isa detected_isa() {
+  static const Isa isa = detail::DetectIsa();
+  return isa;
+}
+
+template <typename Container>
+typename Container::value_type sum(const Container& container) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  U result = U();
+  for (auto segment : container.segments()) {
+    result += detail::Sum<U>(isa, segment.begin(), segment.end());
+  }
+  return result;
+}
+
+// for an empty container returns +infinity (or max() for integers)
+template <typename Container>
+typename Container::value_type min(const Container& container) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  U result = detail::MinIdentity<U>();
+  for (auto segment : container.segments()) {
+    U value = detail::Min<U>(isa, segment.begin(), segment.end());
+    result = (value < result) ? value : result;
+  }
+  return result;
+}
+
+// for an empty container returns -infinity (or lowest() for integers)
+template <typename Container>
+typename Container::value_type max(const Container& container) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  U result = detail::MaxIdentity<U>();
+  for (auto segment : container.segments()) {
+    U value = detail::Max<U>(isa, segment.begin(), segment.end());
+    result = (result < value) ? value : result;
+  }
+  return result;
+}
+
+// number of elements strictly greater than 'threshold'
+template <typename Container>
+size_t count_greater(const Container& container,
+                     typename Container::value_type threshold) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  size_t result = 0;
+  for (auto segment : container.segments()) {
+    result +=
+        detail::CountGreater<U>(isa, segment.begin(), segment.end(), threshold);
+  }
+  return result;
+}
+
+// iterator to the first element strictly greater than 'threshold' or end()
+template <typename Container>
+auto find_greater(Container& container,
+                  typename Container::value_type threshold) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  size_t index = 0;
+  for (auto segment : container.segments()) {
+    const U* it =
+        detail::FindGreater<U>(isa, segment.begin(), segment.end(), threshold);
+    if (it != segment.end()) {
+      return container.begin() + (index + (it - segment.begin()));
+    }
+    index += segment.size();
+  }
+  return container.end();
+}
+
+// iterator to the first element equal to 'value' or end()
+template <typename Container>
+auto find(Container& container, typename Container::value_type value) {
+  using U = typename Container::value_type;
+  Isa isa = detected_isa();
+  size_t index = 0;
+  for (auto segment : container.segments()) {
+    const U* it = detail::Find<U>(isa, segment.begin(), segment.end(), value);
+    if (it != segment.end()) {
+      return container.begin() + (index + (it - segment.begin()));
+    }
+    index += segment.size();
+  }
+  return container.end();
+}
+
+}  // namespace simd
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "deque.h"
+
+// binary snapshot of a Deque of trivially copyable T:
+// a fixed header followed by the elements in order, written straight from
+// the chunks with vectored writes (one iovec per chunk) and read back the
+// same way into freshly allocated chunks, no per-element calls either way
+//
+// the byte layout is the host's (endianness, sizeof(T)); the loader checks
+// the header and rejects files written for a different element size
+class DequeSnapshot {
+ public:
+  template <typename T, typename ChunkPolicy, typename Alloc>
+  static void save(const Deque<T, ChunkPolicy, Alloc>& deque, int fd) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "snapshots hold raw bytes, T must be trivially copyable");
+    Header header;
+    header.element_size = sizeof(T);
+    header.size = deque.deque_size;
+    header.first_column = deque.column(deque.first_element);
+
+    std::vector<iovec> buffers;
+    buffers.reserve(deque.LiveRows() + 1);
+    buffers.push_back({&header, sizeof(header)});
+    for (auto segment : deque.segments()) {
+      buffers.push_back({const_cast<T*>(segment.data()),
+                         segment.size() * sizeof(T)});
+    }
+    Transfer(fd, buffers, false);
+  }
+
+  // replaces the contents of 'deque', which is left untouched on failure;
+  // elements keep their column inside a chunk if the chunk sizes match
+  template <typename T, typename ChunkPolicy, typename Alloc>
+  static void load(int fd, Deque<T, ChunkPolicy, Alloc>& deque) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "snapshots hold raw bytes, T must be trivially copyable");
+    Header header;
+    std::vector<iovec> buffers = {{&header, sizeof(header)}};
+    Transfer(fd, buffers, true);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION) {
+      throw std::runtime_error("DequeSnapshot: not a Deque snapshot");
+    }
+    if (header.element_size != sizeof(T)) {
+      throw std::runtime_error("DequeSnapshot: element size mismatch");
+    }
+
+    using Loaded = Deque<T, ChunkPolicy, Alloc>;
+    Loaded loaded(deque.get_allocator());
+    size_t size = size_t(header.size);
+    size_t first = size_t(header.first_column) & (Loaded::chunk_size() - 1);
+    if (size != 0) {
+      loaded.AllocateChain(Loaded::row(first + size - 1) + 1);
+      loaded.first_element = first;
+      buffers.clear();
+      buffers.reserve(loaded.chain_size);
+      for (size_t position = first; position < first + size;) {
+        size_t run = std::min(first + size - position,
+                              Loaded::chunk_size() - Loaded::column(position));
+        loaded.EnsureChunk(Loaded::row(position));
+        buffers.push_back({loaded.Slot(position), run * sizeof(T)});
+        position += run;
+      }
+      Transfer(fd, buffers, true);
+      loaded.deque_size = size;
+    }
+    deque = std::move(loaded);
+  }
+
+ private:
+  static constexpr char MAGIC[8] = "DEQSNAP";
+  static constexpr uint32_t VERSION = 1;
+#ifdef IOV_MAX
+  static constexpr size_t MAX_BUFFERS = IOV_MAX;
+#else
+  static constexpr size_t MAX_BUFFERS = 16;
+#endif
+
+  struct Header {
+    char magic[8] = "DEQSNAP";
+    uint32_t version = VERSION;
+    uint32_t element_size = 0;
+    uint64_t size = 0;
+    uint64_t first_column = 0;
+  };
+
+  // moves every byte of 'buffers' to or from 'fd', MAX_BUFFERS iovecs
+  // per call, resuming after short reads/writes and EINTR
+  static void Transfer(int fd, std::vector<iovec>& buffers, bool reading) {
+    size_t done = 0;
+    while (done < buffers.size()) {
+      if (buffers[done].iov_len == 0) {
+        ++done;
+        continue;
+      }
+      int count = int(std::min(buffers.size() - done, MAX_BUFFERS));
+      ssize_t moved = reading ? readv(fd, buffers.data() + done, count)
+                              : writev(fd, buffers.data() + done, count);
+      if (moved < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(),
+                                reading ? "DequeSnapshot: read"
+                                        : "DequeSnapshot: write");
+      }
+      if (moved == 0) {
+        throw std::runtime_error("DequeSnapshot: truncated snapshot");
+      }
+      size_t left = size_t(moved);
+      while (done < buffers.size() && left >= buffers[done].iov_len) {
+        left -= buffers[done].iov_len;
+        ++done;
+      }
+      if (left != 0) {
+        buffers[done].iov_base = static_cast<char*>(buffers[done].iov_base) +
+                                 left;
+        buffers[done].iov_len -= left;
+      }
+    }
+  }
+};
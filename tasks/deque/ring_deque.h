@@ -0,0 +1,427 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// what push_back/push_front do when a RingDeque is full
+enum class RingOverflow {
+  OVERWRITE,  // drop the element at the opposite end
+  REJECT      // throw std::length_error
+};
+
+// fixed-capacity deque over one power-of-two buffer: element i lives in
+// slot (head + i) & mask, nothing is allocated after construction;
+// iterators, operator[] and push/pop/emplace mirror Deque, so code written
+// against Deque works with a sliding window unchanged
+template <typename T, typename Alloc = std::allocator<T>>
+class RingDeque {
+ private:
+  using TAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using TAllocTraits = std::allocator_traits<TAlloc>;
+
+  TAlloc t_alloc;
+  T* buffer = nullptr;
+  size_t ring_capacity = 0;
+  size_t mask = 0;
+  size_t head = 0;
+  size_t ring_size = 0;
+  RingOverflow overflow;
+
+  static size_t BufferSize(size_t capacity) {
+    size_t result = 1;
+    while (result < capacity) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  T* Slot(size_t index) const {
+    return buffer + ((head + index) & mask);
+  }
+
+  void DeleteElements() {
+    for (size_t i = 0; i < ring_size; ++i) {
+      TAllocTraits::destroy(t_alloc, Slot(i));
+    }
+    ring_size = 0;
+  }
+
+  void DeallocateBuffer() {
+    if (buffer != nullptr) {
+      TAllocTraits::deallocate(t_alloc, buffer, mask + 1);
+      buffer = nullptr;
+    }
+  }
+
+  // true if a push has to drop the element at the other end,
+  // throws if the ring rejects overflow
+  bool MustDrop() const {
+    if (ring_size < ring_capacity) {
+      return false;
+    }
+    if (overflow == RingOverflow::REJECT || ring_capacity == 0) {
+      throw std::length_error("RingDeque is full");
+    }
+    return true;
+  }
+
+ public:
+  using value_type = T;
+  using allocator_type = Alloc;
+
+  template <bool is_constant>
+  class Iterator {
+   private:
+    using Pointer = std::conditional_t<is_constant, const T*, T*>;
+
+    Pointer buffer = nullptr;
+    size_t mask = 0;
+    // logical position, unwrapped: slot is position & mask
+    size_t position = 0;
+
+   public:
+    using value_type = T;
+    using pointer = Pointer;
+    using reference = std::conditional_t<is_constant, const T&, T&>;
+    using difference_type = ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    Iterator(Pointer buffer, size_t mask, size_t position)
+        : buffer(buffer),
+          mask(mask),
+          position(position) {
+    }
+
+    Iterator() = default;
+
+    reference operator*() const {
+      return buffer[position & mask];
+    }
+
+    pointer operator->() const {
+      return buffer + (position & mask);
+    }
+
+    reference operator[](difference_type delta) const {
+      return buffer[(position + delta) & mask];
+    }
+
+    Iterator& operator++() {
+      ++position;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++position;
+      return copy;
+    }
+
+    Iterator& operator--() {
+      --position;
+      return *this;
+    }
+
+    Iterator operator--(int) {
+      Iterator copy = *this;
+      --position;
+      return copy;
+    }
+
+    Iterator& operator+=(difference_type delta) {
+      position += delta;
+      return *this;
+    }
+
+    Iterator& operator-=(difference_type delta) {
+      position -= delta;
+      return *this;
+    }
+
+    friend Iterator operator+(Iterator it, difference_type delta) {
+      return it += delta;
+    }
+
+    friend Iterator operator+(difference_type delta, Iterator it) {
+      return it += delta;
+    }
+
+    friend Iterator operator-(Iterator it, difference_type delta) {
+      return it -= delta;
+    }
+
+    difference_type operator-(const Iterator& other) const {
+      return difference_type(position - other.position);
+    }
+
+    bool operator==(const Iterator& it) const {
+      return position == it.position;
+    }
+    bool operator!=(const Iterator& it) const {
+      return position != it.position;
+    }
+    bool operator<(const Iterator& it) const {
+      return difference_type(position - it.position) < 0;
+    }
+    bool operator<=(const Iterator& it) const {
+      return difference_type(position - it.position) <= 0;
+    }
+    bool operator>(const Iterator& it) const {
+      return difference_type(position - it.position) > 0;
+    }
+    bool operator>=(const Iterator& it) const {
+      return difference_type(position - it.position) >= 0;
+    }
+
+    operator Iterator<true>() const {
+      return Iterator<true>(buffer, mask, position);
+    }
+  };
+
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  RingDeque(size_t capacity, RingOverflow overflow = RingOverflow::OVERWRITE,
+            const Alloc& init_allocator = Alloc())
+      : t_alloc(init_allocator),
+        ring_capacity(capacity),
+        mask(BufferSize(capacity) - 1),
+        overflow(overflow) {
+    buffer = TAllocTraits::allocate(t_alloc, mask + 1);
+  }
+
+  RingDeque(const RingDeque& init)
+      : t_alloc(
+            TAllocTraits::select_on_container_copy_construction(init.t_alloc)),
+        ring_capacity(init.ring_capacity),
+        mask(init.mask),
+        overflow(init.overflow) {
+    buffer = TAllocTraits::allocate(t_alloc, mask + 1);
+    try {
+      for (; ring_size < init.ring_size; ++ring_size) {
+        TAllocTraits::construct(t_alloc, Slot(ring_size),
+                                *init.Slot(ring_size));
+      }
+    } catch (...) {
+      DeleteElements();
+      DeallocateBuffer();
+      throw;
+    }
+  }
+
+  RingDeque(RingDeque&& init)
+      : t_alloc(std::move(init.t_alloc)),
+        buffer(init.buffer),
+        ring_capacity(init.ring_capacity),
+        mask(init.mask),
+        head(init.head),
+        ring_size(init.ring_size),
+        overflow(init.overflow) {
+    init.buffer = nullptr;
+    init.ring_capacity = 0;
+    init.mask = 0;
+    init.head = 0;
+    init.ring_size = 0;
+  }
+
+  ~RingDeque() {
+    DeleteElements();
+    DeallocateBuffer();
+  }
+
+  void swap(RingDeque& other) {
+    if constexpr (TAllocTraits::propagate_on_container_swap::value) {
+      std::swap(t_alloc, other.t_alloc);
+    }
+    std::swap(buffer, other.buffer);
+    std::swap(ring_capacity, other.ring_capacity);
+    std::swap(mask, other.mask);
+    std::swap(head, other.head);
+    std::swap(ring_size, other.ring_size);
+    std::swap(overflow, other.overflow);
+  }
+
+  RingDeque& operator=(const RingDeque& init) {
+    if (this != &init) {
+      RingDeque copy(init);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  RingDeque& operator=(RingDeque&& init) {
+    RingDeque moved(std::move(init));
+    swap(moved);
+    return *this;
+  }
+
+  Alloc get_allocator() const {
+    return Alloc(t_alloc);
+  }
+
+  size_t size() const {
+    return ring_size;
+  }
+
+  size_t capacity() const {
+    return ring_capacity;
+  }
+
+  bool empty() const {
+    return ring_size == 0;
+  }
+
+  bool full() const {
+    return ring_size == ring_capacity;
+  }
+
+  T& operator[](size_t index) {
+    return *Slot(index);
+  }
+
+  const T& operator[](size_t index) const {
+    return *Slot(index);
+  }
+
+  T& at(size_t index) {
+    if (index >= ring_size) {
+      throw std::out_of_range("RingDeque::at");
+    }
+    return *Slot(index);
+  }
+
+  const T& at(size_t index) const {
+    if (index >= ring_size) {
+      throw std::out_of_range("RingDeque::at");
+    }
+    return *Slot(index);
+  }
+
+  iterator begin() {
+    return iterator(buffer, mask, head);
+  }
+  iterator end() {
+    return iterator(buffer, mask, head + ring_size);
+  }
+
+  const_iterator begin() const {
+    return const_iterator(buffer, mask, head);
+  }
+  const_iterator end() const {
+    return const_iterator(buffer, mask, head + ring_size);
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+
+  std::reverse_iterator<iterator> rbegin() {
+    return std::reverse_iterator<iterator>(end());
+  }
+  std::reverse_iterator<iterator> rend() {
+    return std::reverse_iterator<iterator>(begin());
+  }
+
+  std::reverse_iterator<const_iterator> crbegin() const {
+    return std::reverse_iterator<const_iterator>(cend());
+  }
+  std::reverse_iterator<const_iterator> crend() const {
+    return std::reverse_iterator<const_iterator>(cbegin());
+  }
+
+  // on a full ring drops the front element (OVERWRITE) or throws (REJECT);
+  // the new element is built before the old one is dropped, so 'args' may
+  // refer to it
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    bool drop = MustDrop();
+    if (drop && ring_capacity == mask + 1) {
+      // no free slot: the new element replaces the front one in place
+      T value(std::forward<Args>(args)...);
+      T* place = Slot(0);
+      *place = std::move(value);
+      ++head;
+      return *place;
+    }
+    T* place = Slot(ring_size);
+    TAllocTraits::construct(t_alloc, place, std::forward<Args>(args)...);
+    ++ring_size;
+    if (drop) {
+      pop_front();
+    }
+    return *place;
+  }
+
+  // on a full ring drops the back element (OVERWRITE) or throws (REJECT)
+  template <typename... Args>
+  T& emplace_front(Args&&... args) {
+    bool drop = MustDrop();
+    if (drop && ring_capacity == mask + 1) {
+      T value(std::forward<Args>(args)...);
+      T* place = Slot(ring_size - 1);
+      *place = std::move(value);
+      --head;
+      return *place;
+    }
+    T* place = Slot(size_t(-1));
+    TAllocTraits::construct(t_alloc, place, std::forward<Args>(args)...);
+    --head;
+    ++ring_size;
+    if (drop) {
+      pop_back();
+    }
+    return *place;
+  }
+
+  // returns false instead of overwriting or throwing when full
+  bool try_push_back(const T& value) {
+    if (full()) {
+      return false;
+    }
+    emplace_back(value);
+    return true;
+  }
+
+  bool try_push_front(const T& value) {
+    if (full()) {
+      return false;
+    }
+    emplace_front(value);
+    return true;
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  void push_front(const T& value) {
+    emplace_front(value);
+  }
+
+  void push_front(T&& value) {
+    emplace_front(std::move(value));
+  }
+
+  void pop_back() {
+    TAllocTraits::destroy(t_alloc, Slot(ring_size - 1));
+    --ring_size;
+  }
+
+  void pop_front() {
+    TAllocTraits::destroy(t_alloc, Slot(0));
+    ++head;
+    --ring_size;
+  }
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// memory for SpillAllocator: allocations are served from the heap while
+// they fit into 'memory_budget' bytes, after that from a memory-mapped file,
+// so a Deque's total size is bounded by disk instead of RAM
+//
+// the spill is in allocation order, the storage cannot move live chunks:
+// for a Deque used as a queue the chunks allocated first (the head) are on
+// the heap and later ones in the file; heap chunks released at the head are
+// reused at the tail, so the file-backed chunks drift into the middle
+//
+// a file slot is written right after it is handed out, so when the next
+// one is handed out the previous one is paged out: in a growing Deque it
+// just became interior, only the chunk at the growing end stays resident
+// and the rest is left to the page cache; page_out_middle drops every
+// interior chunk at once, e.g. after the head reached the file-backed part
+//
+// the file is a fresh nameless one in 'directory' (O_TMPFILE, or mkstemp
+// and an immediate unlink where that is unsupported): spilled data never
+// outlives the storage and no existing file is touched; not thread-safe,
+// like StackStorage
+class SpillStorage {
+ public:
+  SpillStorage(const std::string& directory, size_t memory_budget)
+      : memory_budget(memory_budget) {
+#ifdef O_TMPFILE
+    file = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+    if (file < 0) {
+      std::string path = directory + "/spill-XXXXXX";
+      file = mkostemp(path.data(), O_CLOEXEC);
+      if (file < 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "SpillStorage: cannot create a file in " +
+                                    directory);
+      }
+      unlink(path.c_str());
+    }
+  }
+
+  SpillStorage(const SpillStorage&) = delete;
+  SpillStorage& operator=(const SpillStorage&) = delete;
+
+  ~SpillStorage() {
+    for (auto& [base, size] : extents) {
+      munmap(base, size);
+    }
+    close(file);
+  }
+
+  void* Allocate(size_t bytes, size_t alignment) {
+    if (memory_used + bytes <= memory_budget) {
+      void* ptr = ::operator new(bytes, std::align_val_t(alignment));
+      memory_used += bytes;
+      return ptr;
+    }
+    alignment = std::max(alignment, SLOT_ALIGNMENT);
+    size_t size = RoundUp(bytes, alignment);
+    auto slots = free_slots.find({size, alignment});
+    if (slots != free_slots.end() && !slots->second.empty()) {
+      char* ptr = slots->second.back();
+      slots->second.pop_back();
+      return HandOut(ptr, size);
+    }
+    size_t offset = 0;
+    if (extent != nullptr) {
+      offset = AlignedOffset(extent_used, alignment);
+    }
+    if (extent == nullptr || offset + size > extent_size) {
+      // the mapping is page aligned, bigger alignments may need padding
+      AddExtent(std::max(EXTENT_BYTES,
+                         RoundUp(size + alignment - 1, PageSize())));
+      offset = AlignedOffset(0, alignment);
+    }
+    extent_used = offset + size;
+    return HandOut(extent + offset, size);
+  }
+
+  void Deallocate(void* ptr, size_t bytes, size_t alignment) {
+    if (IsSpilled(ptr)) {
+      if (ptr == last_slot) {
+        last_slot = nullptr;
+      }
+      alignment = std::max(alignment, SLOT_ALIGNMENT);
+      free_slots[{RoundUp(bytes, alignment), alignment}].push_back(
+          static_cast<char*>(ptr));
+      return;
+    }
+    ::operator delete(ptr, std::align_val_t(alignment));
+    memory_used -= bytes;
+  }
+
+  bool IsSpilled(const void* ptr) const {
+    const char* address = static_cast<const char*>(ptr);
+    auto it = extents.upper_bound(const_cast<char*>(address));
+    if (it == extents.begin()) {
+      return false;
+    }
+    --it;
+    return address < it->first + it->second;
+  }
+
+  // asks the kernel to write back and drop the whole pages of a spilled
+  // range; heap ranges are left alone, the data stays valid either way
+  void PageOut(void* ptr, size_t bytes) {
+    if (!IsSpilled(ptr)) {
+      return;
+    }
+    size_t page = PageSize();
+    size_t first = RoundUp(reinterpret_cast<size_t>(ptr), page);
+    size_t last = (reinterpret_cast<size_t>(ptr) + bytes) / page * page;
+    if (first >= last) {
+      return;
+    }
+#ifdef MADV_PAGEOUT
+    madvise(reinterpret_cast<void*>(first), last - first, MADV_PAGEOUT);
+#else
+    madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+#endif
+  }
+
+  size_t MemoryBytes() const {
+    return memory_used;
+  }
+
+  size_t FileBytes() const {
+    return file_size;
+  }
+
+ private:
+  static constexpr size_t SLOT_ALIGNMENT = alignof(std::max_align_t);
+  static constexpr size_t EXTENT_BYTES = size_t(64) << 20;
+
+  int file = -1;
+  size_t memory_budget;
+  size_t memory_used = 0;
+  size_t file_size = 0;
+  // mapped parts of the file by address
+  std::map<char*, size_t> extents;
+  // the extent new slots are carved from
+  char* extent = nullptr;
+  size_t extent_size = 0;
+  size_t extent_used = 0;
+  // released file slots by size and alignment, so a reused slot is aligned
+  // like a fresh one; Deque chunks all have the same key
+  std::map<std::pair<size_t, size_t>, std::vector<char*>> free_slots;
+  // the file slot handed out last, still resident
+  char* last_slot = nullptr;
+  size_t last_slot_size = 0;
+
+  static size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // the first offset from 'offset' on in the current extent whose address
+  // is a multiple of 'alignment'
+  size_t AlignedOffset(size_t offset, size_t alignment) const {
+    auto address = reinterpret_cast<uintptr_t>(extent) + offset;
+    return RoundUp(address, alignment) - reinterpret_cast<uintptr_t>(extent);
+  }
+
+  // pages out the previous file slot and keeps 'slot' resident instead
+  char* HandOut(char* slot, size_t size) {
+    if (last_slot != nullptr) {
+      PageOut(last_slot, last_slot_size);
+    }
+    last_slot = slot;
+    last_slot_size = size;
+    return slot;
+  }
+
+  static size_t PageSize() {
+    static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+    return page;
+  }
+
+  void AddExtent(size_t size) {
+    // reserves disk blocks up front: a full disk is reported here as
+    // bad_alloc rather than as SIGBUS on first write to the mapping
+    if (posix_fallocate(file, off_t(file_size), off_t(size)) != 0) {
+      throw std::bad_alloc();
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file,
+                      off_t(file_size));
+    if (base == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    extents.emplace(static_cast<char*>(base), size);
+    file_size += size;
+    extent = static_cast<char*>(base);
+    extent_size = size;
+    extent_used = 0;
+  }
+};
+
+// elements are paged out as raw bytes, so T must be trivially copyable
+template <typename T>
+class SpillAllocator {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "spilled chunks hold raw bytes, T must be trivially copyable");
+
+ public:
+  using value_type = T;
+
+  SpillStorage* storage;
+
+  SpillAllocator(SpillStorage& storage_init)
+      : storage(&storage_init) {
+  }
+
+  template <typename U>
+  SpillAllocator(const SpillAllocator<U>& init_alloc)
+      : storage(init_alloc.storage) {
+  }
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(storage->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    storage->Deallocate(ptr, count * sizeof(T), alignof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const SpillAllocator<T>& a, const SpillAllocator<U>& b) {
+  return a.storage == b.storage;
+}
+
+template <typename T, typename U>
+bool operator!=(const SpillAllocator<T>& a, const SpillAllocator<U>& b) {
+  return !(a == b);
+}
+
+// pages out the spilled chunks of 'container' (e.g. a Deque using
+// SpillAllocator) except 'hot_chunks' chunks at either end
+template <typename Container>
+void page_out_middle(Container& container, SpillStorage& storage,
+                     size_t hot_chunks = 1) {
+  size_t chunks = 0;
+  for (auto segment : container.segments()) {
+    std::ignore = segment;
+    ++chunks;
+  }
+  size_t index = 0;
+  for (auto segment : container.segments()) {
+    if (index >= hot_chunks && index + hot_chunks < chunks) {
+      storage.PageOut(segment.data(),
+                      segment.size() * sizeof(*segment.data()));
+    }
+    ++index;
+  }
+}
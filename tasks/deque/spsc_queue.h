@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "deque.h"
+
+// single-producer/single-consumer queue over a chain of Deque-sized chunks:
+// push_back/push_n are called only by the producer thread,
+// pop_front/pop_n only by the consumer thread, both are wait-free
+// (the producer may allocate a chunk, but never waits for the consumer)
+//
+// chunks form a singly linked list  first -> ... -> head -> ... -> tail;
+// chunks before 'consumer_chunk' are fully consumed and the producer
+// reuses them instead of allocating, so a steady-state queue stops
+// touching the allocator
+template <typename T, typename ChunkPolicy = DequeChunkPolicy<>,
+          typename Alloc = std::allocator<T>>
+class SpscQueue {
+ private:
+  static constexpr size_t CHUNK_SIZE = ChunkPolicy::template chunk_size<T>();
+  static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+  static constexpr size_t CACHE_LINE = 64;
+
+  struct Chunk {
+    alignas(T) unsigned char storage[CHUNK_SIZE * sizeof(T)];
+    std::atomic<Chunk*> next{nullptr};
+
+    T* Slot(size_t index) {
+      return reinterpret_cast<T*>(storage) + (index & CHUNK_MASK);
+    }
+  };
+
+  using ChunkAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Chunk>;
+  using ChunkAllocTraits = std::allocator_traits<ChunkAlloc>;
+  using TAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+  using TAllocTraits = std::allocator_traits<TAlloc>;
+
+  // producer side
+  alignas(CACHE_LINE) Chunk* tail_chunk;
+  Chunk* first_chunk;
+  size_t tail_index = 0;
+  ChunkAlloc chunk_alloc;
+  TAlloc t_alloc;
+  alignas(CACHE_LINE) std::atomic<size_t> pushed{0};
+
+  // consumer side
+  alignas(CACHE_LINE) Chunk* head_chunk;
+  size_t head_index = 0;
+  alignas(CACHE_LINE) std::atomic<size_t> popped{0};
+  std::atomic<Chunk*> consumer_chunk;
+
+  Chunk* AllocateChunk() {
+    Chunk* chunk = ChunkAllocTraits::allocate(chunk_alloc, 1);
+    new (chunk) Chunk();
+    return chunk;
+  }
+
+  // takes a consumed chunk if there is one, allocates otherwise
+  Chunk* AcquireChunk() {
+    if (first_chunk != consumer_chunk.load(std::memory_order_acquire)) {
+      Chunk* chunk = first_chunk;
+      first_chunk = first_chunk->next.load(std::memory_order_relaxed);
+      chunk->next.store(nullptr, std::memory_order_relaxed);
+      return chunk;
+    }
+    return AllocateChunk();
+  }
+
+  // returns slot for element 'tail_index', linking a new chunk if needed
+  T* ProducerSlot() {
+    if ((tail_index & CHUNK_MASK) == 0 && tail_index != 0) {
+      Chunk* chunk = AcquireChunk();
+      tail_chunk->next.store(chunk, std::memory_order_release);
+      tail_chunk = chunk;
+    }
+    return tail_chunk->Slot(tail_index);
+  }
+
+  // returns slot for element 'head_index', stepping into the next chunk
+  T* ConsumerSlot() {
+    if ((head_index & CHUNK_MASK) == 0 && head_index != 0) {
+      head_chunk = head_chunk->next.load(std::memory_order_acquire);
+      consumer_chunk.store(head_chunk, std::memory_order_release);
+    }
+    return head_chunk->Slot(head_index);
+  }
+
+ public:
+  using value_type = T;
+
+  explicit SpscQueue(const Alloc& init_allocator = Alloc())
+      : chunk_alloc(init_allocator),
+        t_alloc(init_allocator) {
+    tail_chunk = first_chunk = head_chunk = AllocateChunk();
+    consumer_chunk.store(head_chunk, std::memory_order_relaxed);
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  ~SpscQueue() {
+    size_t end = pushed.load(std::memory_order_acquire);
+    while (head_index != end) {
+      TAllocTraits::destroy(t_alloc, ConsumerSlot());
+      ++head_index;
+    }
+    while (first_chunk != nullptr) {
+      Chunk* next = first_chunk->next.load(std::memory_order_relaxed);
+      first_chunk->~Chunk();
+      ChunkAllocTraits::deallocate(chunk_alloc, first_chunk, 1);
+      first_chunk = next;
+    }
+  }
+
+  // producer only
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    TAllocTraits::construct(t_alloc, ProducerSlot(),
+                            std::forward<Args>(args)...);
+    ++tail_index;
+    pushed.store(tail_index, std::memory_order_release);
+  }
+
+  void push_back(const T& value) {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value) {
+    emplace_back(std::move(value));
+  }
+
+  // producer only: publishes 'count' values from 'first' at once;
+  // if a constructor throws, the values built so far are still published
+  template <typename InputIt>
+  void push_n(InputIt first, size_t count) {
+    try {
+      for (size_t i = 0; i < count; ++i, ++first) {
+        TAllocTraits::construct(t_alloc, ProducerSlot(), *first);
+        ++tail_index;
+      }
+    } catch (...) {
+      pushed.store(tail_index, std::memory_order_release);
+      throw;
+    }
+    pushed.store(tail_index, std::memory_order_release);
+  }
+
+  // consumer only: returns false if the queue is empty
+  bool pop_front(T& value) {
+    if (head_index == pushed.load(std::memory_order_acquire)) {
+      return false;
+    }
+    T* slot = ConsumerSlot();
+    value = std::move(*slot);
+    TAllocTraits::destroy(t_alloc, slot);
+    ++head_index;
+    popped.store(head_index, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only: moves up to 'count' elements into 'out',
+  // returns how many were taken
+  template <typename OutputIt>
+  size_t pop_n(OutputIt out, size_t count) {
+    size_t available = pushed.load(std::memory_order_acquire) - head_index;
+    count = (available < count) ? available : count;
+    for (size_t i = 0; i < count; ++i, ++out) {
+      T* slot = ConsumerSlot();
+      *out = std::move(*slot);
+      TAllocTraits::destroy(t_alloc, slot);
+      ++head_index;
+    }
+    popped.store(head_index, std::memory_order_release);
+    return count;
+  }
+
+  // exact when called by the consumer, a snapshot from any other thread
+  bool empty() const {
+    return pushed.load(std::memory_order_acquire) ==
+           popped.load(std::memory_order_acquire);
+  }
+
+  // snapshot, may be stale by the time it is returned
+  size_t size() const {
+    size_t end = pushed.load(std::memory_order_acquire);
+    size_t begin = popped.load(std::memory_order_acquire);
+    return (end > begin) ? end - begin : 0;
+  }
+};
@@ -0,0 +1,83 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined deque_access_test.cpp
+#include "../deque.h"
+
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// every element through the const and non-const accessors
+template <typename D>
+void CheckAccess(D& deque, const std::deque<int>& expected) {
+  const D& view = deque;
+  assert(view.size() == expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    assert(view.at(i) == expected[i]);
+    assert(view[i] == expected[i]);
+    assert(deque.at(i) == expected[i]);
+    assert(&view.at(i) == &view[i]);
+  }
+  bool thrown = false;
+  try {
+    view.at(expected.size());
+  } catch (const std::out_of_range&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// pop_front recycles the front chunks, so the rows before first_element
+// are null and the const accessors must skip them
+void TestConstAtAfterPopFront() {
+  Deque<int, FixedChunkPolicy<8>> deque;
+  std::deque<int> expected;
+  for (int i = 0; i < 100; ++i) {
+    deque.push_back(i);
+    expected.push_back(i);
+  }
+  for (int i = 0; i < 37; ++i) {
+    deque.pop_front();
+    expected.pop_front();
+  }
+  CheckAccess(deque, expected);
+  deque.push_front(-1);
+  expected.push_front(-1);
+  CheckAccess(deque, expected);
+}
+
+void TestAgainstStd() {
+  std::mt19937 rng(11);
+  for (int round = 0; round < 100; ++round) {
+    Deque<int, FixedChunkPolicy<8>> deque;
+    std::deque<int> expected;
+    for (int step = 0; step < 500; ++step) {
+      int operation = rng() % 6;
+      int value = int(rng() % 1000);
+      if (operation < 2) {
+        deque.push_back(value);
+        expected.push_back(value);
+      } else if (operation == 2) {
+        deque.push_front(value);
+        expected.push_front(value);
+      } else if (operation == 3 && !expected.empty()) {
+        deque.pop_back();
+        expected.pop_back();
+      } else if (operation >= 4 && !expected.empty()) {
+        deque.pop_front();
+        expected.pop_front();
+      }
+    }
+    CheckAccess(deque, expected);
+  }
+}
+
+}  // namespace
+
+int main() {
+  TestConstAtAfterPopFront();
+  TestAgainstStd();
+  std::puts("ok");
+}
@@ -0,0 +1,287 @@
+// g++ -std=c++17 -O1 -pthread -fsanitize=address,undefined
+//     deque_algorithm_test.cpp
+// (or -fsanitize=thread for the shared-chunk case)
+#include "../deque_algorithm.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// no default constructor, so the algorithms cannot default-construct
+// their buffers
+class Value {
+ public:
+  explicit Value(int value)
+      : value(value) {
+  }
+
+  int get() const {
+    return value;
+  }
+
+  bool operator<(const Value& other) const {
+    return value < other.value;
+  }
+
+ private:
+  int value;
+};
+
+template <typename Container>
+std::vector<int> Elements(const Container& container) {
+  std::vector<int> result;
+  for (size_t i = 0; i < container.size(); ++i) {
+    result.push_back(container[i].get());
+  }
+  return result;
+}
+
+template <typename Policy>
+void TestAgainstStd(size_t count, size_t threads, int modulo,
+                    std::mt19937& rng) {
+  Deque<Value, Policy> deque;
+  for (size_t i = 0; i < count; ++i) {
+    Value value(int(rng() % modulo));
+    if (i % 2 == 0) {
+      deque.push_front(value);
+    } else {
+      deque.push_back(value);
+    }
+  }
+  std::vector<int> values = Elements(deque);
+  std::vector<int> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+
+  Deque<Value, Policy> to_sort = deque;
+  segmented::sort(to_sort, std::less<>(), DequeParallel{threads});
+  assert(Elements(to_sort) == sorted);
+
+  auto even = [](const Value& value) { return value.get() % 2 == 0; };
+  Deque<Value, Policy> to_partition = deque;
+  auto it = segmented::partition(to_partition, even, DequeParallel{threads});
+  std::vector<int> partitioned = values;
+  auto middle = std::stable_partition(partitioned.begin(), partitioned.end(),
+                                      [](int x) { return x % 2 == 0; });
+  assert(Elements(to_partition) == partitioned);
+  assert(it - to_partition.begin() == middle - partitioned.begin());
+
+  if (count != 0) {
+    size_t index = rng() % count;
+    Deque<Value, Policy> to_select = deque;
+    segmented::nth_element(to_select, index, std::less<>(),
+                           DequeParallel{threads});
+    std::vector<int> selected = Elements(to_select);
+    assert(selected[index] == sorted[index]);
+    for (size_t i = 0; i < count; ++i) {
+      assert(i < index ? selected[i] <= selected[index]
+                       : selected[i] >= selected[index]);
+    }
+    std::sort(selected.begin(), selected.end());
+    assert(selected == sorted);
+  }
+  // the source shares chunks with the copies under SharedChunkPolicy
+  assert(Elements(deque) == values);
+}
+
+// records the biggest request, every rebound copy into the same place
+template <typename T>
+class RecordingAllocator {
+ public:
+  using value_type = T;
+
+  explicit RecordingAllocator(size_t* largest)
+      : largest(largest) {
+  }
+
+  template <typename U>
+  RecordingAllocator(const RecordingAllocator<U>& other)
+      : largest(other.largest) {
+  }
+
+  T* allocate(size_t count) {
+    *largest = std::max(*largest, count);
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    std::allocator<T>().deallocate(ptr, count);
+  }
+
+  size_t* largest;
+};
+
+template <typename T, typename U>
+bool operator==(const RecordingAllocator<T>& a,
+                const RecordingAllocator<U>& b) {
+  return a.largest == b.largest;
+}
+
+template <typename T, typename U>
+bool operator!=(const RecordingAllocator<T>& a,
+                const RecordingAllocator<U>& b) {
+  return !(a == b);
+}
+
+// the buffer of every algorithm comes from the container's allocator
+void TestScratchAllocator() {
+  const size_t count = 100000;
+  size_t largest = 0;
+  using Alloc = RecordingAllocator<int>;
+  Deque<int, DequeChunkPolicy<>, Alloc> deque{Alloc(&largest)};
+  for (size_t i = 0; i < count; ++i) {
+    deque.push_back(int((i * 7919) % count));
+  }
+  largest = 0;
+  segmented::sort(deque, std::less<>(), DequeParallel{4});
+  assert(largest == count);
+  largest = 0;
+  segmented::partition(
+      deque, [](int x) { return x % 3 == 0; }, DequeParallel{4});
+  assert(largest == count);
+  largest = 0;
+  segmented::nth_element(deque, count / 3, std::less<>(), DequeParallel{4});
+  assert(largest == count);
+  assert(deque[count / 3] == int(count / 3));
+}
+
+std::vector<std::string> Sorted(const Deque<std::string>& deque) {
+  std::vector<std::string> result(deque.begin(), deque.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+// the comparator or predicate throws where only this header's code runs:
+// in a merge of sort, in a partition, in a quickselect round of
+// nth_element; every element must be back in the deque
+void TestThrowingKeepsElements() {
+  const size_t count = 200000;
+  const size_t threads = 4;
+  std::mt19937 rng(9);
+  std::vector<std::string> values;
+  for (size_t i = 0; i < count; ++i) {
+    values.push_back(std::to_string(rng() % 100000));
+  }
+  std::vector<std::string> sorted = values;
+  std::sort(sorted.begin(), sorted.end());
+
+  // the calls sort makes on its runs before the first merge, with the
+  // runs split as in segmented::sort
+  size_t runs = std::min(threads, count / segmented::detail::PARALLEL_GRAIN);
+  size_t run_calls = 0;
+  for (size_t run = 0; run < runs; ++run) {
+    std::vector<std::string> part(values.begin() + count * run / runs,
+                                  values.begin() + count * (run + 1) / runs);
+    std::sort(part.begin(), part.end(),
+              [&](const std::string& a, const std::string& b) {
+                ++run_calls;
+                return a < b;
+              });
+  }
+
+  for (size_t after : {size_t(1), size_t(100), size_t(5000), size_t(150000),
+                       size_t(250000)}) {
+    std::atomic<size_t> calls{0};
+    size_t limit = 0;
+    auto compare = [&](const std::string& a, const std::string& b) {
+      if (++calls == limit) {
+        throw std::runtime_error("compare");
+      }
+      return a < b;
+    };
+    auto check = [&](auto algorithm) {
+      Deque<std::string> deque;
+      for (const std::string& value : values) {
+        deque.push_back(value);
+      }
+      calls = 0;
+      bool thrown = false;
+      try {
+        algorithm(deque);
+      } catch (const std::runtime_error&) {
+        thrown = true;
+      }
+      assert(thrown);
+      assert(Sorted(deque) == sorted);
+    };
+    limit = run_calls + after;
+    check([&](Deque<std::string>& deque) {
+      segmented::sort(deque, compare, DequeParallel{threads});
+    });
+    limit = after;
+    check([&](Deque<std::string>& deque) {
+      segmented::nth_element(deque, count / 2, compare,
+                             DequeParallel{threads});
+    });
+    check([&](Deque<std::string>& deque) {
+      segmented::partition(
+          deque,
+          [&](const std::string& value) {
+            return compare(value, "50000");
+          },
+          DequeParallel{threads});
+    });
+  }
+}
+
+// the comparator throws partway: every element must still be there
+void TestThrowingCompare(size_t threads) {
+  std::mt19937 rng(5);
+  for (int limit : {1, 100, 50000, 500000}) {
+    Deque<std::string> deque;
+    std::vector<std::string> values;
+    for (int i = 0; i < 100000; ++i) {
+      values.push_back(std::to_string(rng() % 1000));
+      deque.push_back(values.back());
+    }
+    std::atomic<int> calls{0};
+    auto compare = [&](const std::string& a, const std::string& b) {
+      if (++calls == limit) {
+        throw std::runtime_error("compare");
+      }
+      return a < b;
+    };
+    try {
+      segmented::sort(deque, compare, DequeParallel{threads});
+    } catch (const std::runtime_error&) {
+    }
+    assert(deque.size() == values.size());
+    segmented::sort(deque, std::less<>(), DequeParallel{threads});
+    for (size_t i = 1; i < deque.size(); ++i) {
+      assert(!(deque[i] < deque[i - 1]));
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 rng(1);
+  for (size_t count : {0, 1, 2, 100, 16384, 40000, 100003, 300001}) {
+    for (size_t threads : {1, 2, 3, 8}) {
+      for (int modulo : {1 << 30, 5}) {
+        TestAgainstStd<DequeChunkPolicy<>>(count, threads, modulo, rng);
+        TestAgainstStd<SharedChunkPolicy<>>(count, threads, modulo, rng);
+      }
+    }
+  }
+  TestThrowingCompare(1);
+  TestThrowingCompare(4);
+  TestThrowingKeepsElements();
+  TestScratchAllocator();
+
+  Deque<std::string> strings;
+  for (int i = 0; i < 50000; ++i) {
+    strings.push_back(std::to_string(rng()));
+  }
+  segmented::sort(strings);
+  for (size_t i = 1; i < strings.size(); ++i) {
+    assert(strings[i - 1] <= strings[i]);
+  }
+  std::puts("ok");
+}
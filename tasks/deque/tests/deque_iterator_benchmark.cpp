@@ -0,0 +1,70 @@
+// g++ -std=c++17 -O2 deque_iterator_benchmark.cpp
+// iterator traversal of Deque: a forward and a backward walk over 50M ints,
+// a strided walk with += and a forward walk over 2M strings; prints seconds
+// for five passes of each
+#include "../deque.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+template <typename Function>
+double Seconds(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+}  // namespace
+
+int main() {
+  const int count = 50'000'000;
+  const int passes = 5;
+  Deque<int> ints;
+  for (int i = 0; i < count; ++i) {
+    ints.push_back(i);
+  }
+
+  long sum = 0;
+  std::printf("forward  %.3f\n", Seconds([&] {
+                for (int pass = 0; pass < passes; ++pass) {
+                  for (auto it = ints.begin(); it != ints.end(); ++it) {
+                    sum += *it;
+                  }
+                }
+              }));
+  std::printf("backward %.3f\n", Seconds([&] {
+                for (int pass = 0; pass < passes; ++pass) {
+                  for (auto it = ints.rbegin(); it != ints.rend(); ++it) {
+                    sum += *it;
+                  }
+                }
+              }));
+  std::printf("stride 7 %.3f\n", Seconds([&] {
+                for (int pass = 0; pass < passes; ++pass) {
+                  auto it = ints.begin();
+                  for (int i = 0; i + 7 < count; i += 7) {
+                    sum += *it;
+                    it += 7;
+                  }
+                }
+              }));
+
+  Deque<std::string> strings;
+  for (int i = 0; i < 2'000'000; ++i) {
+    strings.push_back(std::to_string(i));
+  }
+  size_t length = 0;
+  std::printf("strings  %.3f\n", Seconds([&] {
+                for (int pass = 0; pass < passes; ++pass) {
+                  for (const std::string& string : strings) {
+                    length += string.size();
+                  }
+                }
+              }));
+  std::printf("checksum %ld %zu\n", sum, length);
+}
@@ -0,0 +1,114 @@
+// g++ -std=c++17 -O2 deque_simd_benchmark.cpp
+// std algorithms over Deque::iterator against the simd:: kernels on
+// Deque<float> and Deque<int64_t>, once per instruction set the CPU has;
+// prints milliseconds per full scan
+#include "../deque_simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+namespace {
+
+const char* Name(simd::Isa isa) {
+  switch (isa) {
+    case simd::Isa::AVX2:
+      return "avx2";
+    case simd::Isa::SSE:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
+
+// best of a few runs, the result is kept alive through 'sink'
+template <typename Function>
+double Milliseconds(Function function, double& sink) {
+  double best = 1e30;
+  for (int run = 0; run < 5; ++run) {
+    auto start = std::chrono::steady_clock::now();
+    sink += double(function());
+    best = std::min(best, std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+  }
+  return best;
+}
+
+template <typename U>
+void Run(const char* type, size_t count) {
+  std::mt19937 rng(7);
+  Deque<U> deque;
+  for (size_t i = 0; i < count; ++i) {
+    deque.push_back(U(int(rng() % 2000) - 1000));
+  }
+  // never found, so find scans everything
+  const U missing = U(5000);
+  const U threshold = U(500);
+  double sink = 0;
+
+  std::printf("%s, %zu elements\n", type, count);
+  std::printf("  %-8s sum %7.2f  min %7.2f  count %7.2f  find %7.2f\n",
+              "std",
+              Milliseconds([&] { return std::accumulate(deque.begin(),
+                                                        deque.end(), U()); },
+                           sink),
+              Milliseconds([&] { return *std::min_element(deque.begin(),
+                                                          deque.end()); },
+                           sink),
+              Milliseconds([&] { return std::count_if(
+                                     deque.begin(), deque.end(),
+                                     [&](U x) { return x > threshold; }); },
+                           sink),
+              Milliseconds([&] { return std::find(deque.begin(),
+                                                  deque.end(), missing) -
+                                        deque.begin(); },
+                           sink));
+
+  for (simd::Isa isa : {simd::Isa::SCALAR, simd::Isa::SSE, simd::Isa::AVX2}) {
+    if (isa > simd::detected_isa()) {
+      break;
+    }
+    auto each = [&](auto kernel) {
+      return [&, kernel] {
+        double result = 0;
+        for (auto segment : deque.segments()) {
+          result += double(kernel(segment.begin(), segment.end()));
+        }
+        return result;
+      };
+    };
+    std::printf(
+        "  %-8s sum %7.2f  min %7.2f  count %7.2f  find %7.2f\n", Name(isa),
+        Milliseconds(each([&](const U* first, const U* last) {
+                       return simd::detail::Sum<U>(isa, first, last);
+                     }),
+                     sink),
+        Milliseconds(each([&](const U* first, const U* last) {
+                       return simd::detail::Min<U>(isa, first, last);
+                     }),
+                     sink),
+        Milliseconds(each([&](const U* first, const U* last) {
+                       return simd::detail::CountGreater<U>(isa, first, last,
+                                                            threshold);
+                     }),
+                     sink),
+        Milliseconds(each([&](const U* first, const U* last) {
+                       return simd::detail::Find<U>(isa, first, last,
+                                                    missing) -
+                              first;
+                     }),
+                     sink));
+  }
+  std::printf("  checksum %g\n", sink);
+}
+
+}  // namespace
+
+int main() {
+  std::printf("detected: %s\n", Name(simd::detected_isa()));
+  Run<float>("float", 10'000'000);
+  Run<int64_t>("int64_t", 10'000'000);
+}
@@ -0,0 +1,161 @@
+// g++ -std=c++17 -O1 -pthread -fsanitize=address,undefined
+//     deque_snapshot_test.cpp
+#include "../deque_snapshot.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// an empty file that is gone once closed
+int TemporaryFile() {
+  char path[] = "/tmp/deque-snapshot-XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  unlink(path);
+  return fd;
+}
+
+template <typename D>
+std::vector<long> Elements(const D& deque) {
+  return std::vector<long>(deque.begin(), deque.end());
+}
+
+// 'pushed_front' elements pushed at the front and 'pushed_back' at the
+// back, then 'popped' taken off the front again
+template <typename Policy>
+Deque<long, Policy> Make(long pushed_front, long pushed_back, long popped) {
+  Deque<long, Policy> deque;
+  for (long i = 0; i < pushed_front; ++i) {
+    deque.push_front(-i);
+  }
+  for (long i = 0; i < pushed_back; ++i) {
+    deque.push_back(i * 3);
+  }
+  for (long i = 0; i < popped; ++i) {
+    deque.pop_front();
+  }
+  return deque;
+}
+
+template <typename To, typename From>
+void CheckRoundTrip(const From& saved) {
+  int fd = TemporaryFile();
+  DequeSnapshot::save(saved, fd);
+  off_t start = lseek(fd, 0, SEEK_SET);
+  assert(start == 0);
+  To loaded;
+  loaded.push_back(42);
+  DequeSnapshot::load(fd, loaded);
+  assert(Elements(loaded) == Elements(saved));
+  // the loaded deque is an ordinary one
+  loaded.push_front(-100);
+  loaded.push_back(100);
+  assert(loaded.size() == saved.size() + 2);
+  assert(loaded[0] == -100 && loaded[loaded.size() - 1] == 100);
+  close(fd);
+}
+
+void TestRoundTrips() {
+  using Small = Deque<long, FixedChunkPolicy<8>>;
+  using Big = Deque<long, FixedChunkPolicy<64>>;
+  // empty, before and after anything was pushed
+  CheckRoundTrip<Small>(Small());
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<8>>(5, 5, 10));
+  // one partial chunk
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<8>>(0, 5, 2));
+  // partial first and last chunks, first_element in the middle of a chunk
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<8>>(13, 22, 3));
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<8>>(0, 1000, 997));
+  // more chunks than one readv/writev call takes
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<8>>(8 * 1500 + 3, 8 * 2000, 5));
+  // a different chunk size on the loading side
+  CheckRoundTrip<Big>(Make<FixedChunkPolicy<8>>(13, 220, 3));
+  CheckRoundTrip<Small>(Make<FixedChunkPolicy<64>>(130, 220, 3));
+  CheckRoundTrip<Deque<long>>(Make<DequeChunkPolicy<>>(12345, 67890, 999));
+}
+
+// through a pipe, reads and writes come back short and are resumed
+void TestPipe() {
+  auto saved = Make<FixedChunkPolicy<8>>(100000, 200000, 7);
+  int fds[2];
+  int piped = pipe(fds);
+  assert(piped == 0);
+  std::thread writer([&] {
+    DequeSnapshot::save(saved, fds[1]);
+    close(fds[1]);
+  });
+  Deque<long, FixedChunkPolicy<8>> loaded;
+  DequeSnapshot::load(fds[0], loaded);
+  writer.join();
+  close(fds[0]);
+  assert(Elements(loaded) == Elements(saved));
+}
+
+// a failed load throws and leaves the target as it was
+template <typename D>
+void CheckRejected(int fd, D& target) {
+  std::vector<long> before = Elements(target);
+  off_t start = lseek(fd, 0, SEEK_SET);
+  assert(start == 0);
+  bool thrown = false;
+  try {
+    DequeSnapshot::load(fd, target);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+  assert(Elements(target) == before);
+}
+
+void TestRejected() {
+  auto saved = Make<FixedChunkPolicy<8>>(30, 70, 4);
+  Deque<long, FixedChunkPolicy<8>> target = Make<FixedChunkPolicy<8>>(3, 4, 0);
+
+  int fd = TemporaryFile();
+  DequeSnapshot::save(saved, fd);
+  off_t full = lseek(fd, 0, SEEK_CUR);
+  // truncated elements, then a truncated header
+  for (off_t length : {full - 1, full - off_t(8 * sizeof(long)), off_t(40),
+                       off_t(20), off_t(0)}) {
+    int truncated = ftruncate(fd, length);
+    assert(truncated == 0);
+    CheckRejected(fd, target);
+  }
+  close(fd);
+
+  // a file that is no snapshot
+  fd = TemporaryFile();
+  std::vector<char> garbage(256, 'x');
+  ssize_t written = write(fd, garbage.data(), garbage.size());
+  assert(written == ssize_t(garbage.size()));
+  CheckRejected(fd, target);
+  close(fd);
+
+  // a snapshot of another element size
+  fd = TemporaryFile();
+  Deque<int> ints;
+  for (int i = 0; i < 100; ++i) {
+    ints.push_back(i);
+  }
+  DequeSnapshot::save(ints, fd);
+  CheckRejected(fd, target);
+  close(fd);
+}
+
+}  // namespace
+
+int main() {
+  TestRoundTrips();
+  TestPipe();
+  TestRejected();
+  std::puts("ok");
+}
@@ -0,0 +1,81 @@
+// g++ -std=c++17 -O2 -pthread deque_sort_benchmark.cpp
+// std::sort / std::nth_element / std::stable_partition over
+// Deque::iterator against their segmented:: versions on one thread and on
+// all hardware threads; prints seconds per run
+#include "../deque_algorithm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+template <typename Function>
+double Seconds(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+Deque<int> RandomDeque(size_t count) {
+  std::mt19937 rng(1);
+  Deque<int> deque;
+  for (size_t i = 0; i < count; ++i) {
+    deque.push_back(int(rng()));
+  }
+  return deque;
+}
+
+void Run(size_t count) {
+  const Deque<int> source = RandomDeque(count);
+  DequeParallel one{1};
+  DequeParallel all;
+  auto even = [](int value) { return value % 2 == 0; };
+
+  Deque<int> a = source;
+  Deque<int> b = source;
+  Deque<int> c = source;
+  double std_sort = Seconds([&] { std::sort(a.begin(), a.end()); });
+  double sort_one =
+      Seconds([&] { segmented::sort(b, std::less<>(), one); });
+  double sort_all =
+      Seconds([&] { segmented::sort(c, std::less<>(), all); });
+  std::printf("%9zu sort          std %.4f  segmented x1 %.4f  x%zu %.4f\n",
+              count, std_sort, sort_one, all.threads, sort_all);
+
+  a = source;
+  b = source;
+  c = source;
+  size_t middle = count / 2;
+  double std_nth = Seconds(
+      [&] { std::nth_element(a.begin(), a.begin() + middle, a.end()); });
+  double nth_one = Seconds(
+      [&] { segmented::nth_element(b, middle, std::less<>(), one); });
+  double nth_all = Seconds(
+      [&] { segmented::nth_element(c, middle, std::less<>(), all); });
+  std::printf("%9zu nth_element   std %.4f  segmented x1 %.4f  x%zu %.4f\n",
+              count, std_nth, nth_one, all.threads, nth_all);
+
+  a = source;
+  b = source;
+  c = source;
+  double std_partition =
+      Seconds([&] { std::stable_partition(a.begin(), a.end(), even); });
+  double partition_one =
+      Seconds([&] { segmented::partition(b, even, one); });
+  double partition_all =
+      Seconds([&] { segmented::partition(c, even, all); });
+  std::printf("%9zu partition     std %.4f  segmented x1 %.4f  x%zu %.4f\n",
+              count, std_partition, partition_one, all.threads,
+              partition_all);
+}
+
+}  // namespace
+
+int main() {
+  for (size_t count : {100'000, 1'000'000, 10'000'000}) {
+    Run(count);
+  }
+}
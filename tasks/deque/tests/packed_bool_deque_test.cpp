@@ -0,0 +1,119 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined packed_bool_deque_test.cpp
+#include "../deque.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+// random pushes, pops, writes, counts and searches against std::deque<bool>
+template <typename Policy>
+void TestAgainstStd() {
+  std::mt19937 rng(3);
+  for (int round = 0; round < 200; ++round) {
+    Deque<bool, PackedBoolPolicy<Policy>> deque;
+    std::deque<bool> expected;
+    for (int step = 0; step < 600; ++step) {
+      int operation = rng() % 8;
+      bool value = rng() % 3 == 0;
+      if (operation < 2) {
+        deque.push_back(value);
+        expected.push_back(value);
+      } else if (operation < 4) {
+        deque.push_front(value);
+        expected.push_front(value);
+      } else if (operation == 4 && !expected.empty()) {
+        deque.pop_back();
+        expected.pop_back();
+      } else if (operation == 5 && !expected.empty()) {
+        deque.pop_front();
+        expected.pop_front();
+      } else if (operation == 6 && !expected.empty()) {
+        size_t index = rng() % expected.size();
+        deque[index] = value;
+        deque.at(index).flip();
+        expected[index] = !value;
+      }
+      const auto& packed = deque;
+      assert(std::equal(packed.begin(), packed.end(), expected.begin(),
+                        expected.end()));
+      size_t first = rng() % (expected.size() + 1);
+      size_t last = rng() % (expected.size() + 1);
+      if (first > last) {
+        std::swap(first, last);
+      }
+      assert(packed.count(first, last) ==
+             size_t(std::count(expected.begin() + first,
+                               expected.begin() + last, true)));
+      for (bool searched : {true, false}) {
+        size_t found = std::find(expected.begin() + first,
+                                 expected.begin() + last, searched) -
+                       expected.begin();
+        assert(packed.find_first(searched, first, last) == found);
+      }
+    }
+    std::sort(deque.begin(), deque.end());
+    std::sort(expected.begin(), expected.end());
+    assert(std::equal(deque.rbegin(), deque.rend(), expected.rbegin(),
+                      expected.rend()));
+    Deque<bool, PackedBoolPolicy<Policy>> copy = deque;
+    deque.flip();
+    for (size_t i = 0; i < expected.size(); ++i) {
+      assert(deque[i] != copy[i]);
+    }
+  }
+}
+
+void TestLarge() {
+  Deque<bool, PackedBoolPolicy<>> deque(100000, true);
+  assert(deque.count() == 100000 && deque.find_first(false) == 100000);
+  deque[77777] = false;
+  assert(deque.find_first(false) == 77777);
+  bool thrown = false;
+  try {
+    deque.at(100000);
+  } catch (const std::out_of_range&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// without the policy Deque<bool> is the plain Deque, middle insert/erase
+// and segments() included
+void TestPlainDequeOfBool() {
+  Deque<bool> deque;
+  std::deque<bool> expected;
+  for (int i = 0; i < 1000; ++i) {
+    deque.push_back(i % 3 == 0);
+    expected.push_back(i % 3 == 0);
+  }
+  deque.insert(deque.begin() + 500, true);
+  expected.insert(expected.begin() + 500, true);
+  deque.emplace(deque.begin() + 10, false);
+  expected.emplace(expected.begin() + 10, false);
+  deque.erase(deque.begin() + 700);
+  expected.erase(expected.begin() + 700);
+  size_t total = 0;
+  for (auto segment : deque.segments()) {
+    total += segment.size();
+    static_assert(std::is_same_v<decltype(segment.data()), bool*>);
+  }
+  assert(total == expected.size());
+  assert(std::equal(deque.begin(), deque.end(), expected.begin(),
+                    expected.end()));
+}
+
+}  // namespace
+
+int main() {
+  TestAgainstStd<FixedChunkPolicy<2>>();
+  TestAgainstStd<DequeChunkPolicy<>>();
+  TestAgainstStd<SharedChunkPolicy<FixedChunkPolicy<4>>>();
+  TestLarge();
+  TestPlainDequeOfBool();
+  std::puts("ok");
+}
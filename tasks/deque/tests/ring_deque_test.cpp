@@ -0,0 +1,174 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined ring_deque_test.cpp
+#include "../deque.h"
+#include "../ring_deque.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <deque>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// the ring holds what the reference holds, seen through operator[], at,
+// the iterators both ways and iterator arithmetic
+void CheckSame(RingDeque<std::string>& ring,
+               const std::deque<std::string>& expected) {
+  const RingDeque<std::string>& view = ring;
+  assert(ring.size() == expected.size());
+  assert(ring.empty() == expected.empty());
+  assert(ring.full() == (expected.size() == ring.capacity()));
+  assert(size_t(ring.end() - ring.begin()) == expected.size());
+  assert(std::equal(ring.begin(), ring.end(), expected.begin(),
+                    expected.end()));
+  assert(std::equal(view.begin(), view.end(), expected.begin(),
+                    expected.end()));
+  assert(std::equal(ring.rbegin(), ring.rend(), expected.rbegin(),
+                    expected.rend()));
+  assert(std::equal(view.crbegin(), view.crend(), expected.rbegin(),
+                    expected.rend()));
+  for (size_t i = 0; i < expected.size(); ++i) {
+    assert(ring[i] == expected[i] && view[i] == expected[i]);
+    assert(ring.at(i) == expected[i] && view.at(i) == expected[i]);
+    assert(ring.begin()[i] == expected[i]);
+    assert(*(ring.end() - (expected.size() - i)) == expected[i]);
+    RingDeque<std::string>::const_iterator it = ring.begin() + i;
+    assert(it - view.begin() == ptrdiff_t(i) && *it == expected[i]);
+    assert(view.begin() <= it && it < view.end());
+  }
+  bool thrown = false;
+  try {
+    view.at(expected.size());
+  } catch (const std::out_of_range&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// random pushes and pops at both ends, far more than the capacity, so
+// the ring wraps around many times in both directions
+void TestAgainstStd(size_t capacity, RingOverflow overflow) {
+  std::mt19937 rng(unsigned(capacity) * 2 + unsigned(overflow));
+  RingDeque<std::string> ring(capacity, overflow);
+  std::deque<std::string> expected;
+  assert(ring.capacity() == capacity);
+  for (int step = 0; step < 3000; ++step) {
+    std::string value = std::to_string(step);
+    int operation = rng() % 10;
+    bool full = expected.size() == capacity;
+    if (operation < 4) {
+      bool back = operation < 2;
+      if (full && overflow == RingOverflow::REJECT) {
+        bool thrown = false;
+        try {
+          if (back) {
+            ring.push_back(value);
+          } else {
+            ring.emplace_front(value);
+          }
+        } catch (const std::length_error&) {
+          thrown = true;
+        }
+        assert(thrown);
+      } else if (back) {
+        std::string& pushed = ring.emplace_back(value);
+        assert(pushed == value);
+        expected.push_back(value);
+        if (full) {
+          expected.pop_front();
+        }
+      } else {
+        ring.push_front(value);
+        expected.push_front(value);
+        if (full) {
+          expected.pop_back();
+        }
+      }
+    } else if (operation < 6) {
+      bool back = operation == 4;
+      bool pushed = back ? ring.try_push_back(value)
+                         : ring.try_push_front(value);
+      assert(pushed == !full);
+      if (pushed && back) {
+        expected.push_back(value);
+      } else if (pushed) {
+        expected.push_front(value);
+      }
+    } else if (operation < 8 && !expected.empty()) {
+      ring.pop_back();
+      expected.pop_back();
+    } else if (!expected.empty()) {
+      ring.pop_front();
+      expected.pop_front();
+    }
+    CheckSame(ring, expected);
+  }
+
+  RingDeque<std::string> copy = ring;
+  CheckSame(copy, expected);
+  RingDeque<std::string> moved = std::move(copy);
+  CheckSame(moved, expected);
+}
+
+// a full OVERWRITE ring replaces the element at the other end with one
+// built from an element of its own
+void TestOverwriteFromItself() {
+  for (size_t capacity : {4, 5}) {
+    RingDeque<std::string> ring(capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+      ring.push_back(std::string(20, char('a' + i)));
+    }
+    ring.push_back(ring[0]);
+    assert(ring[capacity - 1] == std::string(20, 'a'));
+    assert(ring[0] == std::string(20, 'b'));
+    ring.push_front(ring[capacity - 1]);
+    assert(ring[0] == std::string(20, 'a') && ring.size() == capacity);
+  }
+}
+
+// sliding window code written against Deque, run unchanged on a ring
+template <typename Window>
+std::vector<int> WindowMaxima(Window& window, const std::vector<int>& values,
+                              size_t width) {
+  std::vector<int> maxima;
+  for (int value : values) {
+    if (window.size() == width) {
+      window.pop_front();
+    }
+    window.push_back(value);
+    maxima.push_back(*std::max_element(window.begin(), window.end()));
+    maxima.push_back(std::accumulate(window.begin(), window.end(), 0));
+    maxima.push_back(window[window.size() / 2]);
+  }
+  return maxima;
+}
+
+void TestWindowCode() {
+  std::mt19937 rng(17);
+  std::vector<int> values(5000);
+  for (int& value : values) {
+    value = int(rng() % 1000);
+  }
+  for (size_t width : {1, 7, 16, 100}) {
+    Deque<int> deque;
+    RingDeque<int> ring(width, RingOverflow::REJECT);
+    assert(WindowMaxima(deque, values, width) ==
+           WindowMaxima(ring, values, width));
+  }
+}
+
+}  // namespace
+
+int main() {
+  for (size_t capacity : {1, 2, 3, 4, 5, 8, 13}) {
+    TestAgainstStd(capacity, RingOverflow::OVERWRITE);
+    TestAgainstStd(capacity, RingOverflow::REJECT);
+  }
+  TestOverwriteFromItself();
+  TestWindowCode();
+  std::puts("ok");
+}
@@ -0,0 +1,61 @@
+// g++ -std=c++17 -O2 shared_chunk_benchmark.cpp
+// copying a Deque of 10M ints with SharedChunkPolicy against a plain copy,
+// and the cost of the first writes that detach chunks of the shared copy;
+// prints milliseconds
+#include "../deque.h"
+
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+template <typename Function>
+double Milliseconds(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+template <typename Deque>
+Deque Filled(int count) {
+  Deque deque;
+  for (int i = 0; i < count; ++i) {
+    deque.push_back(i);
+  }
+  return deque;
+}
+
+}  // namespace
+
+int main() {
+  const int count = 10'000'000;
+  long sink = 0;
+
+  auto plain = Filled<Deque<int>>(count);
+  std::printf("plain copy              %8.2f\n", Milliseconds([&] {
+                Deque<int> copy(plain);
+                sink += copy[count / 2];
+              }));
+
+  auto shared = Filled<Deque<int, SharedChunkPolicy<>>>(count);
+  Deque<int, SharedChunkPolicy<>> copy;
+  std::printf("shared copy             %8.2f\n", Milliseconds([&] {
+                copy = Deque<int, SharedChunkPolicy<>>(shared);
+              }));
+  // one write per thousand elements detaches a chunk each time
+  std::printf("writes into the copy    %8.2f\n", Milliseconds([&] {
+                for (int i = 0; i < count; i += 1000) {
+                  copy[i] = -i;
+                }
+              }));
+  std::printf("writes after detaching  %8.2f\n", Milliseconds([&] {
+                for (int i = 0; i < count; i += 1000) {
+                  copy[i] = i;
+                }
+              }));
+  const auto& original = shared;
+  sink += original[count / 2] + copy[count - 1];
+  std::printf("checksum %ld\n", sink);
+}
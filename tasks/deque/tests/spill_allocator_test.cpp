@@ -0,0 +1,135 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined spill_allocator_test.cpp
+#include "../deque.h"
+#include "../spill_allocator.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string MakeDirectory() {
+  char path[] = "/tmp/spill-test-XXXXXX";
+  char* directory = mkdtemp(path);
+  assert(directory != nullptr);
+  return directory;
+}
+
+bool IsAligned(const void* ptr, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+// the storage must leave files already in its directory alone
+void TestDirectoryUntouched(const std::string& directory) {
+  std::string path = directory + "/data";
+  std::ofstream(path) << "keep me";
+  {
+    SpillStorage storage(directory, 0);
+    std::memset(storage.Allocate(1 << 16, 8), 1, 1 << 16);
+  }
+  std::string content;
+  std::getline(std::ifstream(path), content);
+  assert(content == "keep me");
+  std::remove(path.c_str());
+}
+
+void TestMissingDirectory() {
+  bool thrown = false;
+  try {
+    SpillStorage storage("/nonexistent/spill", 0);
+  } catch (const std::system_error&) {
+    thrown = true;
+  }
+  assert(thrown);
+}
+
+// freed file slots are reused only for requests of the same alignment
+void TestSlotAlignment(const std::string& directory) {
+  SpillStorage storage(directory, 0);
+  for (size_t alignment : {size_t(8), size_t(64), size_t(256), size_t(8192)}) {
+    std::vector<void*> slots;
+    for (int i = 0; i < 50; ++i) {
+      // odd offsets in the extent for the next request
+      storage.Deallocate(storage.Allocate(24, 8), 24, 8);
+      slots.push_back(storage.Allocate(100, alignment));
+      assert(storage.IsSpilled(slots.back()));
+      assert(IsAligned(slots.back(), alignment));
+    }
+    for (void* slot : slots) {
+      storage.Deallocate(slot, 100, alignment);
+    }
+    for (size_t other : {size_t(8), size_t(64), size_t(256), size_t(8192)}) {
+      void* slot = storage.Allocate(100, other);
+      assert(IsAligned(slot, other));
+      storage.Deallocate(slot, 100, other);
+    }
+  }
+}
+
+// every new file slot pages out the previous one, which must read back
+void TestPagedOutSlots(const std::string& directory) {
+  SpillStorage storage(directory, 0);
+  const size_t bytes = 1 << 16;
+  std::vector<char*> slots;
+  for (int i = 0; i < 64; ++i) {
+    slots.push_back(static_cast<char*>(storage.Allocate(bytes, 8)));
+    std::memset(slots.back(), i, bytes);
+  }
+  storage.Deallocate(slots[10], bytes, 8);
+  slots[10] = static_cast<char*>(storage.Allocate(bytes, 8));
+  std::memset(slots[10], 10, bytes);
+  storage.Allocate(bytes, 8);
+  for (int i = 0; i < 64; ++i) {
+    for (size_t j = 0; j < bytes; j += 4093) {
+      assert(slots[i][j] == char(i));
+    }
+  }
+}
+
+void TestDeque(const std::string& directory) {
+  SpillStorage storage(directory, 1 << 16);
+  {
+    Deque<long, DequeChunkPolicy<>, SpillAllocator<long>> deque{
+        SpillAllocator<long>(storage)};
+    const long count = 1'000'000;
+    for (long i = 0; i < count; ++i) {
+      deque.push_back(i);
+    }
+    assert(storage.MemoryBytes() <= (1 << 16));
+    assert(storage.FileBytes() >= count * sizeof(long) - (1 << 16));
+    page_out_middle(deque, storage, 2);
+    for (long i = 0; i < count; i += 997) {
+      assert(deque[i] == i);
+    }
+    for (long i = 0; i < count / 2; ++i) {
+      deque.pop_front();
+    }
+    size_t file_bytes = storage.FileBytes();
+    for (long i = 0; i < count / 2; ++i) {
+      deque.push_back(i);
+    }
+    assert(storage.FileBytes() == file_bytes);
+    for (long i = 0; i < count / 2; i += 1001) {
+      assert(deque[i] == i + count / 2 && deque[count / 2 + i] == i);
+    }
+  }
+  assert(storage.MemoryBytes() == 0);
+}
+
+}  // namespace
+
+int main() {
+  std::string directory = MakeDirectory();
+  TestDirectoryUntouched(directory);
+  TestMissingDirectory();
+  TestSlotAlignment(directory);
+  TestPagedOutSlots(directory);
+  TestDeque(directory);
+  rmdir(directory.c_str());
+  std::puts("ok");
+}
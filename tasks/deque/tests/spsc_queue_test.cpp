@@ -0,0 +1,146 @@
+// g++ -std=c++17 -O1 -pthread -fsanitize=address,undefined spsc_queue_test.cpp
+// (or -fsanitize=thread for the two-thread cases)
+#include "../spsc_queue.h"
+
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// counts the chunks the queue allocates
+template <typename T>
+class CountingAllocator {
+ public:
+  using value_type = T;
+
+  explicit CountingAllocator(size_t* allocations)
+      : allocations(allocations) {
+  }
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& other)
+      : allocations(other.allocations) {
+  }
+
+  T* allocate(size_t count) {
+    ++*allocations;
+    return std::allocator<T>().allocate(count);
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    std::allocator<T>().deallocate(ptr, count);
+  }
+
+  size_t* allocations;
+};
+
+using Queue = SpscQueue<long, FixedChunkPolicy<8>>;
+
+// one producer and one consumer over many chunk boundaries: every value
+// arrives once and in order, whichever of the single and batch paths
+// pushed and popped it; with a bounded 'lag' the producer keeps reusing
+// chunks the consumer has just left
+void TestTwoThreads(long count, size_t lag) {
+  Queue queue;
+  std::thread producer([&] {
+    long next = 0;
+    std::vector<long> batch;
+    while (next < count) {
+      while (queue.size() > lag) {
+        std::this_thread::yield();
+      }
+      long step = next % 7;
+      if (step < 3) {
+        queue.push_back(next++);
+      } else if (step == 3) {
+        queue.emplace_back(next++);
+      } else {
+        batch.clear();
+        for (long i = 0; i < step * 3 && next < count; ++i) {
+          batch.push_back(next++);
+        }
+        queue.push_n(batch.begin(), batch.size());
+      }
+    }
+  });
+  long expected = 0;
+  std::vector<long> batch(20);
+  while (expected < count) {
+    long before = expected;
+    if (expected % 2 == 0) {
+      long value;
+      if (queue.pop_front(value)) {
+        assert(value == expected);
+        ++expected;
+      }
+    } else {
+      size_t taken = queue.pop_n(batch.begin(), batch.size());
+      for (size_t i = 0; i < taken; ++i) {
+        assert(batch[i] == expected);
+        ++expected;
+      }
+    }
+    if (expected == before) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  long value;
+  bool popped = queue.pop_front(value);
+  assert(!popped && queue.empty() && queue.size() == 0);
+}
+
+// consumed chunks are handed back to the producer: a queue that is
+// drained between rounds stops allocating after the first one
+void TestRecycledChunks() {
+  size_t allocations = 0;
+  using Alloc = CountingAllocator<long>;
+  SpscQueue<long, FixedChunkPolicy<8>, Alloc> queue{Alloc(&allocations)};
+  long next = 0;
+  long expected = 0;
+  size_t after_first = 0;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 50; ++i) {
+      queue.push_back(next++);
+    }
+    std::vector<long> out(50);
+    size_t taken = queue.pop_n(out.begin(), out.size());
+    assert(taken == out.size());
+    for (long value : out) {
+      assert(value == expected++);
+    }
+    if (round == 0) {
+      after_first = allocations;
+    }
+  }
+  // one more chunk while the consumer still sits in its last one
+  assert(allocations <= after_first + 1);
+}
+
+// the values still queued are destroyed with the queue
+void TestDestroysRest() {
+  SpscQueue<std::string, FixedChunkPolicy<8>> queue;
+  for (int i = 0; i < 100; ++i) {
+    queue.push_back(std::string(100, char('a' + i % 26)));
+  }
+  std::string value;
+  for (int i = 0; i < 30; ++i) {
+    bool popped = queue.pop_front(value);
+    assert(popped);
+    assert(value == std::string(100, char('a' + i % 26)));
+  }
+  assert(queue.size() == 70);
+}
+
+}  // namespace
+
+int main() {
+  TestTwoThreads(1'000'000, size_t(-1));
+  TestTwoThreads(200'000, 40);
+  TestRecycledChunks();
+  TestDestroysRest();
+  std::puts("ok");
+}
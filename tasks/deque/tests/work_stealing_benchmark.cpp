@@ -0,0 +1,83 @@
+// g++ -std=c++17 -O2 -pthread work_stealing_benchmark.cpp
+// fork-join workloads on WorkStealingPool at 1..N threads, N being the
+// hardware concurrency (at least 4): a recursive fibonacci with a small
+// sequential cutoff and a parallel reduction that splits its range in two
+// down to a leaf size; prints seconds per workload
+#include "../work_stealing.h"
+
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+template <typename Function>
+double Seconds(Function function) {
+  auto start = std::chrono::steady_clock::now();
+  function();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+long SequentialFibonacci(int n) {
+  return n < 2 ? n : SequentialFibonacci(n - 1) + SequentialFibonacci(n - 2);
+}
+
+long Fibonacci(WorkStealingPool& pool, int n, int cutoff) {
+  if (n < cutoff) {
+    return SequentialFibonacci(n);
+  }
+  long left = 0;
+  WorkStealingPool::TaskGroup group;
+  pool.submit(group, [&] { left = Fibonacci(pool, n - 1, cutoff); });
+  long right = Fibonacci(pool, n - 2, cutoff);
+  pool.wait(group);
+  return left + right;
+}
+
+long Sum(WorkStealingPool& pool, const long* first, const long* last,
+         size_t leaf) {
+  if (size_t(last - first) <= leaf) {
+    return std::accumulate(first, last, 0L);
+  }
+  const long* middle = first + (last - first) / 2;
+  long left = 0;
+  WorkStealingPool::TaskGroup group;
+  pool.submit(group, [&] { left = Sum(pool, first, middle, leaf); });
+  long right = Sum(pool, middle, last, leaf);
+  pool.wait(group);
+  return left + right;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<long> values(1 << 26);
+  std::iota(values.begin(), values.end(), 0);
+  const long* first = values.data();
+  const long* last = first + values.size();
+
+  long expected = 0;
+  double sequential = Seconds([&] { expected = SequentialFibonacci(36); });
+  std::printf("sequential fib(36) %.3f (%ld)\n", sequential, expected);
+
+  size_t max_threads =
+      std::max<size_t>(4, std::thread::hardware_concurrency());
+  for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+    WorkStealingPool pool(threads);
+    long fibonacci = 0;
+    double fibonacci_seconds = Seconds([&] {
+      pool.submit([&] { fibonacci = Fibonacci(pool, 36, 20); });
+      pool.wait();
+    });
+    long sum = 0;
+    double sum_seconds = Seconds([&] {
+      pool.submit([&] { sum = Sum(pool, first, last, 1 << 12); });
+      pool.wait();
+    });
+    std::printf("%2zu threads  fib(36) %.3f (%ld)  sum of 2^26 %.3f (%ld)\n",
+                threads, fibonacci_seconds, fibonacci, sum_seconds, sum);
+  }
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "deque.h"
+
+// identifies a scheduled timer; stays safe to cancel after the timer
+// fired or was cancelled, a stale handle is simply ignored
+struct TimerHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+};
+
+// hierarchical timing wheel (Varghese, Lauck, SOSP'87): LEVELS wheels of
+// SLOTS slots, level l slot s holds the timers whose expiry differs from
+// now() first in bits [SLOT_BITS * l, SLOT_BITS * (l + 1)) and has s there;
+// when now() reaches a slot of a higher level its timers are cascaded down
+//
+// schedule and cancel are O(1), advance is O(1) per tick plus the timers
+// it cascades and fires; slots are Deques of handles, so filling a slot is
+// a push_back and draining it reuses the chunks; cancelled timers are
+// dropped lazily when their slot is drained
+//
+// callbacks run inside advance and may schedule or cancel timers, but
+// must not call advance; not thread-safe
+template <typename Callback = std::function<void()>>
+class TimerWheel {
+ private:
+  static constexpr size_t SLOT_BITS = 6;
+  static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+  static constexpr size_t SLOT_MASK = SLOTS - 1;
+  static constexpr size_t LEVELS = (64 + SLOT_BITS - 1) / SLOT_BITS;
+
+  using Slot = Deque<TimerHandle, DequeChunkPolicy<1024>>;
+
+  struct Timer {
+    uint64_t expiry = 0;
+    uint32_t generation = 0;
+    bool pending = false;
+    Callback callback;
+  };
+
+  uint64_t current_tick = 0;
+  size_t pending_count = 0;
+  std::vector<Timer> timers;
+  std::vector<uint32_t> free_timers;
+  std::vector<Slot> wheels;
+  // handles being cascaded or fired, kept to reuse its memory
+  std::vector<TimerHandle> batch;
+
+  static size_t Level(uint64_t expiry, uint64_t now) {
+    uint64_t differ = expiry ^ now;
+    if (differ == 0) {
+      return 0;
+    }
+    return (63 - size_t(__builtin_clzll(differ))) / SLOT_BITS;
+  }
+
+  // bits of a tick below level 'level'
+  static uint64_t LowBits(size_t level) {
+    return (uint64_t(1) << (level * SLOT_BITS)) - 1;
+  }
+
+  Slot& SlotOf(size_t level, uint64_t tick) {
+    return wheels[level * SLOTS + ((tick >> (level * SLOT_BITS)) & SLOT_MASK)];
+  }
+
+  void Place(TimerHandle handle) {
+    uint64_t expiry = timers[handle.index].expiry;
+    SlotOf(Level(expiry, current_tick), expiry).push_back(handle);
+  }
+
+  void Release(uint32_t index) {
+    Timer& timer = timers[index];
+    timer.pending = false;
+    ++timer.generation;
+    timer.callback = Callback();
+    free_timers.push_back(index);
+    --pending_count;
+  }
+
+  // moves the live timers of level 'level''s current slot to lower levels
+  void Cascade(size_t level) {
+    batch.clear();
+    Slot& slot = SlotOf(level, current_tick);
+    slot.pop_front_n(slot.size(), std::back_inserter(batch));
+    for (TimerHandle handle : batch) {
+      if (pending(handle)) {
+        Place(handle);
+      }
+    }
+  }
+
+  // fires the live timers of the current level 0 slot
+  size_t Expire() {
+    batch.clear();
+    Slot& slot = SlotOf(0, current_tick);
+    slot.pop_front_n(slot.size(), std::back_inserter(batch));
+    size_t fired = 0;
+    for (TimerHandle handle : batch) {
+      if (!pending(handle)) {
+        continue;
+      }
+      Callback callback = std::move(timers[handle.index].callback);
+      Release(handle.index);
+      ++fired;
+      callback();
+    }
+    return fired;
+  }
+
+ public:
+  TimerWheel()
+      : wheels(LEVELS * SLOTS) {
+  }
+
+  // time is counted in ticks, starting from 'start'
+  explicit TimerWheel(uint64_t start)
+      : current_tick(start),
+        wheels(LEVELS * SLOTS) {
+  }
+
+  uint64_t now() const {
+    return current_tick;
+  }
+
+  size_t size() const {
+    return pending_count;
+  }
+
+  bool empty() const {
+    return pending_count == 0;
+  }
+
+  // runs 'callback' once now() has advanced by 'delay' ticks,
+  // a delay of 0 counts as 1
+  TimerHandle schedule(uint64_t delay, Callback callback) {
+    uint32_t index;
+    if (free_timers.empty()) {
+      index = uint32_t(timers.size());
+      timers.emplace_back();
+    } else {
+      index = free_timers.back();
+      free_timers.pop_back();
+    }
+    Timer& timer = timers[index];
+    timer.expiry = current_tick + std::max<uint64_t>(delay, 1);
+    timer.pending = true;
+    timer.callback = std::move(callback);
+    ++pending_count;
+    TimerHandle handle{index, timer.generation};
+    Place(handle);
+    return handle;
+  }
+
+  bool pending(TimerHandle handle) const {
+    return handle.index < timers.size() &&
+           timers[handle.index].generation == handle.generation &&
+           timers[handle.index].pending;
+  }
+
+  // true if the timer was pending; its slot entry is dropped lazily
+  bool cancel(TimerHandle handle) {
+    if (!pending(handle)) {
+      return false;
+    }
+    Release(handle.index);
+    return true;
+  }
+
+  // moves now() forward by 'ticks', firing every timer that expires on
+  // the way, tick by tick; returns the number of timers fired
+  size_t advance(uint64_t ticks) {
+    size_t fired = 0;
+    for (; ticks != 0; --ticks) {
+      if (pending_count == 0) {
+        // nothing can cascade or fire, the slots hold stale entries only
+        current_tick += ticks;
+        break;
+      }
+      ++current_tick;
+      // levels whose lower levels all wrapped around on this tick
+      size_t top = 0;
+      while (top + 1 < LEVELS && (current_tick & LowBits(top + 1)) == 0) {
+        ++top;
+      }
+      for (size_t level = top; level > 0; --level) {
+        Cascade(level);
+      }
+      fired += Expire();
+    }
+    return fired;
+  }
+};
@@ -0,0 +1,433 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "deque.h"
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Nardelli, PPoPP'13):
+// the owner thread calls push_back/pop_back, any thread may steal_front
+//
+// elements live in Deque-sized chunks addressed through a circular map;
+// growing doubles the map and re-links the live chunks into it, so no
+// element is ever copied and thieves holding the old map still read the
+// right chunk; old maps are kept until destruction
+template <typename T, typename ChunkPolicy = DequeChunkPolicy<>,
+          typename Alloc = std::allocator<T>>
+class WorkStealingDeque {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "thieves read slots racily, T must be trivially copyable");
+
+ private:
+  static constexpr size_t CHUNK_SIZE = ChunkPolicy::template chunk_size<T>();
+  static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+  static constexpr size_t ChunkShift() {
+    size_t shift = 0;
+    while ((size_t(1) << shift) < CHUNK_SIZE) {
+      ++shift;
+    }
+    return shift;
+  }
+
+  static constexpr size_t CHUNK_SHIFT = ChunkShift();
+  static constexpr size_t CACHE_LINE = 64;
+
+  using Cell = std::atomic<T>;
+
+  struct Map {
+    size_t mask;
+    Cell** chunks;
+
+    Cell& Slot(int64_t index) const {
+      return chunks[(size_t(index) >> CHUNK_SHIFT) & mask]
+                   [size_t(index) & CHUNK_MASK];
+    }
+
+    int64_t Capacity() const {
+      return int64_t((mask + 1) * CHUNK_SIZE);
+    }
+  };
+
+  using CellAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Cell>;
+  using ChunksAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Cell*>;
+  using CellAllocTraits = std::allocator_traits<CellAlloc>;
+  using ChunksAllocTraits = std::allocator_traits<ChunksAlloc>;
+
+  alignas(CACHE_LINE) std::atomic<int64_t> top{0};
+  alignas(CACHE_LINE) std::atomic<int64_t> bottom{0};
+  std::atomic<Map*> map;
+  CellAlloc cell_alloc;
+  ChunksAlloc chunks_alloc;
+  // every map ever used, the last one is current
+  std::vector<Map*> maps;
+
+  Cell* AllocateChunk() {
+    Cell* chunk = CellAllocTraits::allocate(cell_alloc, CHUNK_SIZE);
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+      new (chunk + i) Cell();
+    }
+    return chunk;
+  }
+
+  Map* AllocateMap(size_t slots) {
+    std::unique_ptr<Map> new_map(new Map{slots - 1, nullptr});
+    new_map->chunks = ChunksAllocTraits::allocate(chunks_alloc, slots);
+    std::fill(new_map->chunks, new_map->chunks + slots, nullptr);
+    maps.push_back(new_map.get());
+    return new_map.release();
+  }
+
+  // doubles the map: live rows keep their chunks, remaining slots get the
+  // old spare chunks first and fresh ones after that
+  Map* Grow(Map* old_map, int64_t first, int64_t last) {
+    maps.reserve(maps.size() + 1);
+    Map* new_map = AllocateMap(2 * (old_map->mask + 1));
+    std::vector<Cell*> spare;
+    std::vector<bool> live(old_map->mask + 1, false);
+    size_t first_row = size_t(first) >> CHUNK_SHIFT;
+    size_t last_row = (last == first) ? first_row
+                                      : (size_t(last - 1) >> CHUNK_SHIFT) + 1;
+    for (size_t row = first_row; row < last_row; ++row) {
+      live[row & old_map->mask] = true;
+      new_map->chunks[row & new_map->mask] =
+          old_map->chunks[row & old_map->mask];
+    }
+    for (size_t i = 0; i <= old_map->mask; ++i) {
+      if (!live[i]) {
+        spare.push_back(old_map->chunks[i]);
+      }
+    }
+    for (size_t i = 0; i <= new_map->mask; ++i) {
+      if (new_map->chunks[i] == nullptr) {
+        if (spare.empty()) {
+          new_map->chunks[i] = AllocateChunk();
+        } else {
+          new_map->chunks[i] = spare.back();
+          spare.pop_back();
+        }
+      }
+    }
+    map.store(new_map, std::memory_order_release);
+    return new_map;
+  }
+
+ public:
+  using value_type = T;
+
+  explicit WorkStealingDeque(const Alloc& init_allocator = Alloc())
+      : cell_alloc(init_allocator),
+        chunks_alloc(init_allocator) {
+    Map* first_map = AllocateMap(2);
+    first_map->chunks[0] = AllocateChunk();
+    first_map->chunks[1] = AllocateChunk();
+    map.store(first_map, std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  ~WorkStealingDeque() {
+    Map* current = map.load(std::memory_order_relaxed);
+    for (size_t i = 0; i <= current->mask; ++i) {
+      CellAllocTraits::deallocate(cell_alloc, current->chunks[i], CHUNK_SIZE);
+    }
+    for (Map* old_map : maps) {
+      ChunksAllocTraits::deallocate(chunks_alloc, old_map->chunks,
+                                    old_map->mask + 1);
+      delete old_map;
+    }
+  }
+
+  // owner only
+  void push_back(T value) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Map* current = map.load(std::memory_order_relaxed);
+    // keep one chunk of slack so both ends never share a chunk slot
+    if (b - t >= current->Capacity() - int64_t(CHUNK_SIZE)) {
+      current = Grow(current, t, b);
+    }
+    current->Slot(b).store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // owner only: takes the most recently pushed element
+  bool pop_back(T& value) {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Map* current = map.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    value = current->Slot(b).load(std::memory_order_relaxed);
+    if (t == b) {
+      // last element: race against thieves for it
+      bool won = top.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  // any thread: takes the oldest element, false if empty or lost a race
+  bool steal_front(T& value) {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    Map* current = map.load(std::memory_order_acquire);
+    value = current->Slot(t).load(std::memory_order_relaxed);
+    return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed);
+  }
+
+  // snapshot, may be stale by the time it is returned
+  size_t size() const {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_relaxed);
+    return (b > t) ? size_t(b - t) : 0;
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+};
+
+// fixed-size thread pool with one WorkStealingDeque per worker:
+// tasks submitted from a worker go to its own deque (LIFO for the owner),
+// tasks from outside go to a shared injection Deque, idle workers steal
+//
+// fork-join: submit children into a TaskGroup and wait() on it from the
+// parent task, waiting threads keep executing tasks instead of blocking
+class WorkStealingPool {
+ public:
+  class TaskGroup {
+   public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+   private:
+    friend class WorkStealingPool;
+
+    std::atomic<size_t> pending{0};
+    std::mutex exception_mutex;
+    std::exception_ptr exception;
+  };
+
+  explicit WorkStealingPool(
+      size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+      : queues(threads) {
+    for (auto& queue : queues) {
+      queue = std::make_unique<WorkStealingDeque<Task*>>();
+    }
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  ~WorkStealingPool() {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stop = true;
+    }
+    sleep_condition.notify_all();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  size_t thread_count() const {
+    return workers.size();
+  }
+
+  template <typename Function>
+  void submit(TaskGroup& group, Function&& function) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    Push(new Task{std::function<void()>(std::forward<Function>(function)),
+                  &group});
+  }
+
+  template <typename Function>
+  void submit(Function&& function) {
+    submit(default_group, std::forward<Function>(function));
+  }
+
+  // runs tasks until every task of 'group' has finished,
+  // rethrows the first exception thrown by one of them
+  void wait(TaskGroup& group) {
+    size_t self = CurrentWorker();
+    while (group.pending.load(std::memory_order_acquire) != 0) {
+      if (!RunOne(self)) {
+        std::this_thread::yield();
+      }
+    }
+    std::exception_ptr exception;
+    {
+      std::lock_guard<std::mutex> lock(group.exception_mutex);
+      std::swap(exception, group.exception);
+    }
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  // waits for the tasks submitted without a group
+  void wait() {
+    wait(default_group);
+  }
+
+ private:
+  struct Task {
+    std::function<void()> function;
+    TaskGroup* group;
+  };
+
+  static constexpr size_t NOT_A_WORKER = size_t(-1);
+  static constexpr int SPINS_BEFORE_SLEEP = 64;
+
+  std::vector<std::unique_ptr<WorkStealingDeque<Task*>>> queues;
+  std::vector<std::thread> workers;
+  TaskGroup default_group;
+
+  std::mutex injection_mutex;
+  Deque<Task*> injection;
+
+  // tasks pushed but not yet taken, lets idle workers sleep
+  std::atomic<size_t> queued{0};
+  std::atomic<size_t> sleeping{0};
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_condition;
+  bool stop = false;
+
+  static WorkStealingPool*& CurrentPool() {
+    static thread_local WorkStealingPool* pool = nullptr;
+    return pool;
+  }
+
+  static size_t& CurrentIndex() {
+    static thread_local size_t index = NOT_A_WORKER;
+    return index;
+  }
+
+  size_t CurrentWorker() const {
+    return (CurrentPool() == this) ? CurrentIndex() : NOT_A_WORKER;
+  }
+
+  void Push(Task* task) {
+    size_t self = CurrentWorker();
+    if (self != NOT_A_WORKER) {
+      queues[self]->push_back(task);
+    } else {
+      std::lock_guard<std::mutex> lock(injection_mutex);
+      injection.push_back(task);
+    }
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst) != 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      sleep_condition.notify_one();
+    }
+  }
+
+  Task* Take(size_t self) {
+    Task* task = nullptr;
+    if (self != NOT_A_WORKER && queues[self]->pop_back(task)) {
+      return task;
+    }
+    {
+      std::lock_guard<std::mutex> lock(injection_mutex);
+      if (injection.size() != 0) {
+        task = injection[0];
+        injection.pop_front();
+        return task;
+      }
+    }
+    static thread_local uint64_t seed = 0x9e3779b97f4a7c15ull;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    size_t start = size_t(seed % queues.size());
+    for (size_t i = 0; i < queues.size(); ++i) {
+      size_t victim = (start + i) % queues.size();
+      if (victim != self && queues[victim]->steal_front(task)) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  bool RunOne(size_t self) {
+    Task* task = Take(self);
+    if (task == nullptr) {
+      return false;
+    }
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    std::unique_ptr<Task> owner(task);
+    try {
+      task->function();
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(task->group->exception_mutex);
+      if (!task->group->exception) {
+        task->group->exception = std::current_exception();
+      }
+    }
+    task->group->pending.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  void WorkerLoop(size_t index) {
+    CurrentPool() = this;
+    CurrentIndex() = index;
+    int idle = 0;
+    while (true) {
+      if (RunOne(index)) {
+        idle = 0;
+        continue;
+      }
+      if (++idle < SPINS_BEFORE_SLEEP) {
+        std::this_thread::yield();
+        continue;
+      }
+      sleeping.fetch_add(1, std::memory_order_seq_cst);
+      bool stopping = false;
+      {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleep_condition.wait(lock, [this] {
+          return stop || queued.load(std::memory_order_seq_cst) != 0;
+        });
+        stopping = stop;
+      }
+      sleeping.fetch_sub(1, std::memory_order_seq_cst);
+      if (stopping) {
+        break;
+      }
+      idle = 0;
+    }
+  }
+};
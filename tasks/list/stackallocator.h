@@ -1,7 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <utility>
 #include <vector>
 #include <stdexcept>
@@ -10,12 +17,21 @@
 template <size_t N>
 class StackStorage {
  public:
+  // offset of the first free byte in the current block
   int shift = 0;
   char storage[N];
 
   StackStorage(){};
   StackStorage(const StackStorage&) = delete;
-  ~StackStorage(){};
+
+  // blocks needed once 'storage' is full come from 'upstream'
+  explicit StackStorage(std::pmr::memory_resource* upstream)
+      : upstream(upstream) {
+  }
+
+  ~StackStorage() {
+    Release();
+  }
 
   int GetShift() {
     return shift;
@@ -28,6 +44,107 @@ class StackStorage {
   char* GetStorage() {
     return storage;
   }
+
+  // bump allocation from the current block; when it is full a new block,
+  // at least twice as large as the previous one, is chained from upstream
+  void* Allocate(size_t bytes, size_t alignment) {
+    void* ptr = current + shift;
+    size_t free_space = current_size - shift;
+    if (std::align(alignment, bytes, ptr, free_space) == nullptr) {
+      AddBlock(bytes + alignment);
+      ptr = current;
+      free_space = current_size;
+      std::align(alignment, bytes, ptr, free_space);
+    }
+    shift = int(static_cast<char*>(ptr) + bytes - current);
+    return ptr;
+  }
+
+  // only the most recent allocation is given back (LIFO),
+  // other blocks are reclaimed by Rewind or Release
+  void Deallocate(void* ptr, size_t bytes) {
+    char* block = static_cast<char*>(ptr);
+    if (block + bytes == current + shift) {
+      shift = int(block - current);
+    }
+  }
+
+  struct Mark {
+    void* block = nullptr;
+    int shift = 0;
+  };
+
+  // everything allocated after Checkpoint() is released at once by
+  // Rewind(mark), chained blocks are returned upstream;
+  // containers using that memory must be gone by then
+  Mark Checkpoint() const {
+    return {blocks, shift};
+  }
+
+  void Rewind(const Mark& mark) {
+    while (blocks != mark.block) {
+      Block* block = blocks;
+      blocks = block->previous;
+      upstream->deallocate(block, sizeof(Block) + block->size,
+                           alignof(std::max_align_t));
+    }
+    current = (blocks == nullptr) ? storage : Data(blocks);
+    current_size = (blocks == nullptr) ? N : blocks->size;
+    shift = mark.shift;
+  }
+
+  // frees every chained block and empties the storage
+  void Release() {
+    Rewind(Mark());
+  }
+
+  // rewinds the storage to where it was when the marker was created
+  class Marker {
+   public:
+    explicit Marker(StackStorage& storage)
+        : storage(storage),
+          mark(storage.Checkpoint()) {
+    }
+
+    Marker(const Marker&) = delete;
+    Marker& operator=(const Marker&) = delete;
+
+    ~Marker() {
+      storage.Rewind(mark);
+    }
+
+   private:
+    StackStorage& storage;
+    Mark mark;
+  };
+
+ private:
+  struct alignas(std::max_align_t) Block {
+    Block* previous;
+    size_t size;
+  };
+
+  std::pmr::memory_resource* upstream = std::pmr::new_delete_resource();
+  // newest chained block, null while 'storage' is in use
+  Block* blocks = nullptr;
+  char* current = storage;
+  size_t current_size = N;
+
+  static char* Data(Block* block) {
+    return reinterpret_cast<char*>(block + 1);
+  }
+
+  void AddBlock(size_t min_size) {
+    size_t size = std::max(min_size, 2 * std::max<size_t>(current_size, 64));
+    Block* block = static_cast<Block*>(upstream->allocate(
+        sizeof(Block) + size, alignof(std::max_align_t)));
+    block->previous = blocks;
+    block->size = size;
+    blocks = block;
+    current = Data(block);
+    current_size = size;
+    shift = 0;
+  }
 };
 
 template <typename T, size_t N>
@@ -64,22 +181,16 @@ class StackAllocator {
   }
 
   T* allocate(size_t count) {
-    void* ptr = reinterpret_cast<void*>(storage->storage + storage->shift);
-    size_t free_space = N - storage->shift;
-    std::align(alignof(T), count * sizeof(T), ptr, free_space);
-    storage->Set(reinterpret_cast<char*>(ptr) - storage->storage);
-    size_t old_shift = storage->shift;
-    storage->shift += sizeof(T) * count;
-    return reinterpret_cast<T*>(storage->storage + old_shift);
+    return static_cast<T*>(storage->Allocate(sizeof(T) * count, alignof(T)));
   }
 
-  void deallocate(T* ptr, size_t) {
-    std::ignore = ptr;
+  void deallocate(T* ptr, size_t count) {
+    storage->Deallocate(ptr, sizeof(T) * count);
   }
 
   template <typename... Args>
-  void construct(T* ptr, const Args&... args) {
-    new (ptr) T(args...);
+  void construct(T* ptr, Args&&... args) {
+    new (ptr) T(std::forward<Args>(args)...);
   }
 
   void destroy(T* ptr) {
@@ -101,6 +212,370 @@ bool operator==(const StackAllocator<T, N>& a, const StackAllocator<T, N>& b) {
   return a.storage == b.storage;
 }
 
+// StackStorage that many threads may allocate from at once: the bump
+// pointer of the current block is advanced with fetch_add, a full block
+// is replaced by a larger one chained from upstream under a mutex;
+// Deallocate does nothing, memory comes back with Release(), which must
+// not run concurrently with allocations
+template <size_t N>
+class ConcurrentStackStorage {
+ public:
+  ConcurrentStackStorage()
+      : ConcurrentStackStorage(std::pmr::new_delete_resource()) {
+  }
+
+  explicit ConcurrentStackStorage(std::pmr::memory_resource* upstream)
+      : upstream(upstream) {
+    inline_block.data = storage;
+    inline_block.size = N;
+    current.store(&inline_block, std::memory_order_relaxed);
+  }
+
+  ConcurrentStackStorage(const ConcurrentStackStorage&) = delete;
+  ConcurrentStackStorage& operator=(const ConcurrentStackStorage&) = delete;
+
+  ~ConcurrentStackStorage() {
+    Release();
+  }
+
+  void* Allocate(size_t bytes, size_t alignment) {
+    // blocks hand out multiples of GRAIN, so offsets stay GRAIN-aligned
+    size_t size = RoundUp(bytes, GRAIN) +
+                  (alignment > GRAIN ? alignment - GRAIN : 0);
+    while (true) {
+      Block* block = current.load(std::memory_order_acquire);
+      size_t offset = block->used.fetch_add(size, std::memory_order_relaxed);
+      if (offset + size <= block->size) {
+        void* ptr = block->data + offset;
+        return std::align(alignment, bytes, ptr, size);
+      }
+      Grow(block, size);
+    }
+  }
+
+  void Deallocate(void*, size_t) {
+  }
+
+  // frees every chained block and empties the storage
+  void Release() {
+    Block* block = current.load(std::memory_order_relaxed);
+    while (block != &inline_block) {
+      Block* previous = block->previous;
+      block->~Block();
+      upstream->deallocate(block, sizeof(Block) + block->size,
+                           alignof(Block));
+      block = previous;
+    }
+    inline_block.used.store(0, std::memory_order_relaxed);
+    current.store(&inline_block, std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr size_t GRAIN = alignof(std::max_align_t);
+
+  struct alignas(std::max_align_t) Block {
+    Block* previous = nullptr;
+    char* data = nullptr;
+    size_t size = 0;
+    std::atomic<size_t> used = 0;
+  };
+
+  std::pmr::memory_resource* upstream;
+  std::mutex grow_mutex;
+  std::atomic<Block*> current;
+  Block inline_block;
+  alignas(std::max_align_t) char storage[N];
+
+  static size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // replaces 'full' unless another thread already did
+  void Grow(Block* full, size_t min_size) {
+    std::lock_guard<std::mutex> lock(grow_mutex);
+    if (current.load(std::memory_order_relaxed) != full) {
+      return;
+    }
+    size_t size = std::max(min_size, 2 * std::max<size_t>(full->size, 64));
+    size = RoundUp(size, GRAIN);
+    Block* block = new (upstream->allocate(sizeof(Block) + size,
+                                           alignof(Block))) Block;
+    block->previous = full;
+    block->data = reinterpret_cast<char*>(block + 1);
+    block->size = size;
+    current.store(block, std::memory_order_release);
+  }
+};
+
+// ConcurrentStackStorage with a per-thread cache: every thread carves its
+// allocations from a private SLAB_BYTES slab taken from the shared arena,
+// so the shared bump pointer is touched once per slab, not per allocation;
+// large requests go to the shared arena directly
+template <size_t N, size_t SLAB_BYTES = 64 * 1024>
+class ThreadCachedStackStorage {
+ public:
+  ThreadCachedStackStorage() = default;
+
+  explicit ThreadCachedStackStorage(std::pmr::memory_resource* upstream)
+      : shared(upstream) {
+  }
+
+  void* Allocate(size_t bytes, size_t alignment) {
+    if (bytes + alignment > SLAB_BYTES / 4) {
+      return shared.Allocate(bytes, alignment);
+    }
+    Slab& slab = LocalSlab();
+    void* ptr = slab.cursor;
+    size_t space = slab.end - slab.cursor;
+    if (std::align(alignment, bytes, ptr, space) == nullptr) {
+      slab.cursor = static_cast<char*>(
+          shared.Allocate(SLAB_BYTES, alignof(std::max_align_t)));
+      slab.end = slab.cursor + SLAB_BYTES;
+      ptr = slab.cursor;
+      space = SLAB_BYTES;
+      std::align(alignment, bytes, ptr, space);
+    }
+    slab.cursor = static_cast<char*>(ptr) + bytes;
+    return ptr;
+  }
+
+  void Deallocate(void*, size_t) {
+  }
+
+  // not concurrently with allocations; slabs cached by threads are dropped
+  void Release() {
+    shared.Release();
+    id = NextId();
+  }
+
+ private:
+  // a thread's slab of the storage with id 'owner'
+  struct Slab {
+    uint64_t owner = 0;
+    char* cursor = nullptr;
+    char* end = nullptr;
+  };
+
+  // storages a thread keeps slabs of, the oldest is forgotten beyond that
+  static constexpr size_t CACHED_SLABS = 8;
+
+  ConcurrentStackStorage<N> shared;
+  // unlike the address, never reused by a later storage
+  uint64_t id = NextId();
+
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Slab& LocalSlab() {
+    thread_local std::vector<Slab> slabs;
+    for (Slab& slab : slabs) {
+      if (slab.owner == id) {
+        return slab;
+      }
+    }
+    if (slabs.size() == CACHED_SLABS) {
+      slabs.erase(slabs.begin());
+    }
+    slabs.push_back({id, nullptr, nullptr});
+    return slabs.back();
+  }
+};
+
+// allocator over any storage with Allocate(bytes, alignment) and
+// Deallocate(ptr, bytes), e.g. ConcurrentStackStorage or
+// ThreadCachedStackStorage shared by the containers of several threads
+template <typename T, typename Storage>
+class StorageAllocator {
+ public:
+  using value_type = T;
+
+  Storage* storage;
+
+  StorageAllocator(Storage& storage_init)
+      : storage(&storage_init) {
+  }
+
+  template <typename U>
+  StorageAllocator(const StorageAllocator<U, Storage>& init_alloc)
+      : storage(init_alloc.storage) {
+  }
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(storage->Allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    storage->Deallocate(ptr, sizeof(T) * count);
+  }
+
+  // copies of a container allocate from the same arena
+  StorageAllocator select_on_container_copy_construction() const {
+    return *this;
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = StorageAllocator<U, Storage>;
+  };
+};
+
+template <typename T, typename U, typename Storage>
+bool operator==(const StorageAllocator<T, Storage>& a,
+                const StorageAllocator<U, Storage>& b) {
+  return a.storage == b.storage;
+}
+
+template <typename T, typename U, typename Storage>
+bool operator!=(const StorageAllocator<T, Storage>& a,
+                const StorageAllocator<U, Storage>& b) {
+  return !(a == b);
+}
+
+// fixed-size slots for node-based containers: one pool per slot size,
+// each carving slots out of slabs that double in size up to MAX_SLAB_BYTES
+// and recycling freed slots through an intrusive free list, so a List or
+// UnorderedMap in steady state never reaches the heap; slabs are freed
+// with the storage; not thread-safe, like StackStorage
+class PoolStorage {
+ public:
+  static constexpr size_t GRAIN = alignof(std::max_align_t);
+
+  struct Pool {
+    size_t slot_size = 0;
+    void* free_list = nullptr;
+    char* cursor = nullptr;
+    char* end = nullptr;
+    size_t slab_bytes = 0;
+  };
+
+  PoolStorage() = default;
+  PoolStorage(const PoolStorage&) = delete;
+  PoolStorage& operator=(const PoolStorage&) = delete;
+
+  ~PoolStorage() {
+    for (void* slab : slabs) {
+      ::operator delete(slab, std::align_val_t(GRAIN));
+    }
+  }
+
+  // the pool for objects of 'bytes' bytes, stable for the storage lifetime
+  Pool* PoolFor(size_t bytes) {
+    size_t slot_size = std::max(RoundUp(bytes, GRAIN), sizeof(void*));
+    for (auto& pool : pools) {
+      if (pool->slot_size == slot_size) {
+        return pool.get();
+      }
+    }
+    pools.push_back(std::make_unique<Pool>());
+    pools.back()->slot_size = slot_size;
+    return pools.back().get();
+  }
+
+  void* Allocate(Pool* pool) {
+    if (pool->free_list != nullptr) {
+      void* slot = pool->free_list;
+      pool->free_list = *static_cast<void**>(slot);
+      return slot;
+    }
+    if (pool->cursor == pool->end) {
+      AddSlab(pool);
+    }
+    void* slot = pool->cursor;
+    pool->cursor += pool->slot_size;
+    return slot;
+  }
+
+  void Deallocate(Pool* pool, void* slot) {
+    *static_cast<void**>(slot) = pool->free_list;
+    pool->free_list = slot;
+  }
+
+ private:
+  static constexpr size_t MIN_SLAB_BYTES = 4096;
+  static constexpr size_t MAX_SLAB_BYTES = 1 << 20;
+
+  std::vector<std::unique_ptr<Pool>> pools;
+  std::vector<void*> slabs;
+
+  static size_t RoundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  void AddSlab(Pool* pool) {
+    pool->slab_bytes = std::min(
+        MAX_SLAB_BYTES, std::max(MIN_SLAB_BYTES, pool->slab_bytes * 2));
+    size_t slots = std::max<size_t>(1, pool->slab_bytes / pool->slot_size);
+    size_t bytes = slots * pool->slot_size;
+    slabs.reserve(slabs.size() + 1);
+    char* slab = static_cast<char*>(
+        ::operator new(bytes, std::align_val_t(GRAIN)));
+    slabs.push_back(slab);
+    pool->cursor = slab;
+    pool->end = slab + bytes;
+  }
+};
+
+// allocator of single objects from a PoolStorage: each rebound copy
+// (e.g. to a List's Node and BaseNode) looks up the pool of its own size
+// once; arrays and over-aligned types go to the heap
+template <typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolStorage* storage;
+  PoolStorage::Pool* pool;
+
+  PoolAllocator(PoolStorage& storage_init)
+      : storage(&storage_init),
+        pool(storage_init.PoolFor(sizeof(T))) {
+  }
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>& init_alloc)
+      : storage(init_alloc.storage),
+        pool(storage->PoolFor(sizeof(T))) {
+  }
+
+  T* allocate(size_t count) {
+    if (count != 1 || alignof(T) > PoolStorage::GRAIN) {
+      return static_cast<T*>(
+          ::operator new(sizeof(T) * count, std::align_val_t(alignof(T))));
+    }
+    return static_cast<T*>(storage->Allocate(pool));
+  }
+
+  void deallocate(T* ptr, size_t count) {
+    if (count != 1 || alignof(T) > PoolStorage::GRAIN) {
+      ::operator delete(ptr, std::align_val_t(alignof(T)));
+      return;
+    }
+    storage->Deallocate(pool, ptr);
+  }
+
+  // a copied container keeps drawing from the same storage
+  PoolAllocator select_on_container_copy_construction() const {
+    return *this;
+  }
+
+  template <typename U>
+  struct rebind {
+    using other = PoolAllocator<U>;
+  };
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& a, const PoolAllocator<U>& b) {
+  return a.storage == b.storage;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& a, const PoolAllocator<U>& b) {
+  return !(a == b);
+}
+
 
 template <typename T, typename Alloc = std::allocator<T>>
 class List {
@@ -160,7 +635,8 @@ class List {
   template <typename... Args>
    List(PrivateConstructorTag, int new_capacity = 0, Alloc init_allocator = Alloc(), Args&&... args)
       : node_alloc(init_allocator),
-        basenode_alloc(init_allocator) {
+        basenode_alloc(init_allocator),
+        t_alloc(init_allocator) {
     InitFakeNode();
 
     try {
@@ -314,6 +790,10 @@ class List {
   }
 
   void DestroyFakeNode() {
+    // moved-from lists own no fake node
+    if (fake_node == nullptr) {
+      return;
+    }
     std::allocator_traits<BaseNodeAlloc>::destroy(basenode_alloc, fake_node);
     std::allocator_traits<BaseNodeAlloc>::deallocate(basenode_alloc, fake_node,
                                                      1);
@@ -321,7 +801,8 @@ class List {
 
   List(const Alloc& init_allocator)
       : node_alloc(init_allocator),
-        basenode_alloc(init_allocator) {
+        basenode_alloc(init_allocator),
+        t_alloc(init_allocator) {
     InitFakeNode();
   }
 
@@ -333,12 +814,14 @@ class List {
     : List(PrivateConstructorTag(), new_capacity, init_allocator, value) {
   }
 
-  List(const List& init) {
-    node_alloc =
-        NodeAllocTraits::select_on_container_copy_construction(init.node_alloc);
-    basenode_alloc = std::allocator_traits<BaseNodeAlloc>::
-        select_on_container_copy_construction(init.basenode_alloc);
-
+  List(const List& init)
+      : node_alloc(NodeAllocTraits::select_on_container_copy_construction(
+            init.node_alloc)),
+        basenode_alloc(std::allocator_traits<BaseNodeAlloc>::
+                           select_on_container_copy_construction(
+                               init.basenode_alloc)),
+        t_alloc(std::allocator_traits<TAlloc>::
+                    select_on_container_copy_construction(init.t_alloc)) {
     InitFakeNode();
     try {
       for (auto& element : init) {
@@ -359,6 +842,7 @@ class List {
     : capacity(std::move(init.capacity)),
       node_alloc(std::move(init.node_alloc)),
       basenode_alloc(std::move(init.basenode_alloc)),
+      t_alloc(std::move(init.t_alloc)),
       fake_node(std::move(init.fake_node)) {
     init.capacity = 0;
     init.fake_node = nullptr;
@@ -390,6 +874,7 @@ class List {
     std::swap(capacity, to_swap.capacity);
     std::swap(node_alloc, to_swap.node_alloc);
     std::swap(basenode_alloc, to_swap.basenode_alloc);
+    std::swap(t_alloc, to_swap.t_alloc);
   }
 
   List& operator=(const List<T, Alloc>& init) {
@@ -461,4 +946,188 @@ class List {
     next_node->prev = prev_node;
     --capacity;
   }
+
+  // splices move nodes between lists with equal allocators,
+  // nothing is allocated, copied or invalidated
+
+  // moves the node at 'it' from 'other' before 'pos'
+  void splice(const const_iterator& pos, List& other,
+              const const_iterator& it) {
+    if (pos.node == it.node || pos.node == it.node->next) {
+      return;
+    }
+    Transfer(pos.node, it.node, it.node->next);
+    --other.capacity;
+    ++capacity;
+  }
+
+  // moves [first, last) from 'other' before 'pos', counting the nodes
+  // when the lists differ
+  void splice(const const_iterator& pos, List& other,
+              const const_iterator& first, const const_iterator& last) {
+    if (&other != this) {
+      size_t count = 0;
+      for (BaseNode* node = first.node; node != last.node; node = node->next) {
+        ++count;
+      }
+      other.capacity -= count;
+      capacity += count;
+    }
+    Transfer(pos.node, first.node, last.node);
+  }
+
+  // moves all of 'other' before 'pos' in O(1)
+  void splice(const const_iterator& pos, List& other) {
+    if (&other == this) {
+      return;
+    }
+    Transfer(pos.node, other.fake_node->next, other.fake_node);
+    capacity += other.capacity;
+    other.capacity = 0;
+  }
+
+  // merges sorted 'other' into this sorted list, stable: of equal
+  // elements those of *this come first
+  template <typename Compare = std::less<T>>
+  void merge(List& other, Compare compare = Compare()) {
+    if (&other == this) {
+      return;
+    }
+    BaseNode* node = fake_node->next;
+    BaseNode* other_node = other.fake_node->next;
+    while (node != fake_node && other_node != other.fake_node) {
+      if (compare(Value(other_node), Value(node))) {
+        BaseNode* next = other_node->next;
+        Transfer(node, other_node, next);
+        --other.capacity;
+        ++capacity;
+        other_node = next;
+      } else {
+        node = node->next;
+      }
+    }
+    splice(end(), other);
+  }
+
+  // stable bottom-up merge sort that only relinks nodes: runs of 2^i nodes
+  // wait in bins[i] as null-terminated chains, the same way a binary
+  // counter carries; if 'compare' throws, all elements stay in the list
+  // in unspecified order
+  template <typename Compare = std::less<T>>
+  void sort(Compare compare = Compare()) {
+    if (capacity < 2) {
+      return;
+    }
+    BaseNode* chain = fake_node->next;
+    fake_node->prev->next = nullptr;
+    BaseNode* bins[64] = {};
+    try {
+      while (chain != nullptr) {
+        BaseNode* run = chain;
+        chain = chain->next;
+        run->next = nullptr;
+        size_t i = 0;
+        for (; bins[i] != nullptr; ++i) {
+          MergeChains(bins[i], run, compare);
+          run = bins[i];
+          bins[i] = nullptr;
+        }
+        bins[i] = run;
+      }
+      for (size_t i = 1; i < 64; ++i) {
+        BaseNode* run = bins[i - 1];
+        if (run == nullptr) {
+          continue;
+        }
+        // the bin is emptied first: on a throw MergeChains leaves all the
+        // nodes in bins[i], they must not be reachable from two bins
+        bins[i - 1] = nullptr;
+        if (bins[i] == nullptr) {
+          bins[i] = run;
+        } else {
+          MergeChains(bins[i], run, compare);
+        }
+      }
+    } catch (...) {
+      for (BaseNode* bin : bins) {
+        chain = Concatenate(chain, bin);
+      }
+      RelinkChain(chain);
+      throw;
+    }
+    RelinkChain(bins[63]);
+  }
+
+ private:
+  static T& Value(BaseNode* node) {
+    return static_cast<Node*>(node)->value;
+  }
+
+  // moves [first, last) before 'pos', which must not lie inside it
+  static void Transfer(BaseNode* pos, BaseNode* first, BaseNode* last) {
+    if (first == last || pos == last) {
+      return;
+    }
+    BaseNode* tail = last->prev;
+    first->prev->next = last;
+    last->prev = first->prev;
+    BaseNode* before = pos->prev;
+    before->next = first;
+    first->prev = before;
+    tail->next = pos;
+    pos->prev = tail;
+  }
+
+  static BaseNode* Concatenate(BaseNode* first, BaseNode* second) {
+    if (first == nullptr) {
+      return second;
+    }
+    BaseNode* tail = first;
+    while (tail->next != nullptr) {
+      tail = tail->next;
+    }
+    tail->next = second;
+    return first;
+  }
+
+  // merges the sorted null-terminated chains 'left' and 'right' into
+  // 'left', taking from 'left' on ties; if 'compare' throws, 'left'
+  // still holds every node
+  template <typename Compare>
+  static void MergeChains(BaseNode*& left, BaseNode* right,
+                          Compare& compare) {
+    BaseNode head;
+    BaseNode* tail = &head;
+    BaseNode* rest = left;
+    try {
+      while (rest != nullptr && right != nullptr) {
+        if (compare(Value(right), Value(rest))) {
+          tail->next = right;
+          right = right->next;
+        } else {
+          tail->next = rest;
+          rest = rest->next;
+        }
+        tail = tail->next;
+      }
+    } catch (...) {
+      tail->next = nullptr;
+      left = Concatenate(Concatenate(head.next, rest), right);
+      throw;
+    }
+    tail->next = (rest != nullptr) ? rest : right;
+    left = head.next;
+  }
+
+  // makes the null-terminated chain from 'first' the list's node ring
+  void RelinkChain(BaseNode* first) {
+    BaseNode* prev = fake_node;
+    for (BaseNode* node = first; node != nullptr; node = node->next) {
+      node->prev = prev;
+      prev->next = node;
+      prev = node;
+    }
+    prev->next = fake_node;
+    fake_node->prev = prev;
+  }
 };
\ No newline at end of file
@@ -0,0 +1,128 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined list_sort_test.cpp
+#include "../stackallocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <vector>
+
+namespace {
+
+using Pair = std::pair<int, int>;
+
+bool LessFirst(const Pair& lhs, const Pair& rhs) {
+  return lhs.first < rhs.first;
+}
+
+template <typename L>
+auto Elements(const L& list) {
+  return std::vector<std::decay_t<decltype(*list.begin())>>(list.begin(),
+                                                             list.end());
+}
+
+// walks the ring both ways, so a broken prev link or a cycle shows up
+template <typename T>
+size_t CheckLinks(const List<T>& list) {
+  size_t forward = 0;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    ++forward;
+    assert(forward <= list.size());
+  }
+  size_t backward = 0;
+  for (auto it = list.end(); it != list.begin();) {
+    --it;
+    ++backward;
+    assert(backward <= list.size());
+  }
+  assert(forward == list.size() && backward == list.size());
+  return forward;
+}
+
+void TestStableSort() {
+  std::mt19937 rng(2);
+  for (int n : {0, 1, 2, 3, 7, 64, 65, 1000, 4097}) {
+    List<Pair> list;
+    std::list<Pair> expected;
+    for (int i = 0; i < n; ++i) {
+      Pair value{int(rng() % 50), i};
+      list.push_back(value);
+      expected.push_back(value);
+    }
+    list.sort(LessFirst);
+    expected.sort(LessFirst);
+    CheckLinks(list);
+    assert(Elements(list) == Elements(expected));
+  }
+}
+
+void TestMerge() {
+  std::mt19937 rng(3);
+  List<Pair> list;
+  List<Pair> other;
+  std::list<Pair> expected;
+  std::list<Pair> expected_other;
+  for (int i = 0; i < 500; ++i) {
+    Pair value{int(rng() % 50), i};
+    (i % 3 == 0 ? other : list).push_back(value);
+    (i % 3 == 0 ? expected_other : expected).push_back(value);
+  }
+  list.sort(LessFirst);
+  other.sort(LessFirst);
+  expected.sort(LessFirst);
+  expected_other.sort(LessFirst);
+  list.merge(other, LessFirst);
+  expected.merge(expected_other, LessFirst);
+  assert(other.size() == 0);
+  CheckLinks(list);
+  assert(Elements(list) == Elements(expected));
+}
+
+// the comparator throws on its 'limit'-th call; the list must keep every
+// element with intact links and still be sortable afterwards
+void TestThrowingCompare(int n, int limit) {
+  std::mt19937 rng(n * 7919 + limit);
+  List<int> list;
+  std::vector<int> values;
+  for (int i = 0; i < n; ++i) {
+    values.push_back(int(rng() % 100));
+    list.push_back(values.back());
+  }
+  int calls = 0;
+  bool thrown = false;
+  try {
+    list.sort([&](int lhs, int rhs) {
+      if (++calls == limit) {
+        throw limit;
+      }
+      return lhs < rhs;
+    });
+  } catch (int) {
+    thrown = true;
+  }
+  assert(CheckLinks(list) == size_t(n));
+  std::vector<int> kept = Elements(list);
+  std::sort(kept.begin(), kept.end());
+  std::sort(values.begin(), values.end());
+  assert(kept == values);
+  if (!thrown) {
+    assert(std::is_sorted(list.begin(), list.end()));
+  }
+  list.sort();
+  assert(Elements(list) == values);
+}
+
+}  // namespace
+
+int main() {
+  TestStableSort();
+  TestMerge();
+  TestThrowingCompare(3, 2);
+  for (int n : {2, 3, 4, 5, 8, 13, 100}) {
+    for (int limit = 1; limit <= n * 8; ++limit) {
+      TestThrowingCompare(n, limit);
+    }
+  }
+  std::puts("ok");
+}
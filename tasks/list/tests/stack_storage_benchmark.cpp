@@ -0,0 +1,53 @@
+// g++ -std=c++17 -O2 -pthread stack_storage_benchmark.cpp
+// every thread fills a List<std::string> of 50000 elements and empties it,
+// all of them allocating from one shared arena: ConcurrentStackStorage
+// against ThreadCachedStackStorage at 1, 2, 4 and up to the hardware thread
+// count (at least 4); prints seconds
+#include "../stackallocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Storage>
+double Seconds(Storage& storage, unsigned threads, int count) {
+  using Alloc = StorageAllocator<std::string, Storage>;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&storage, count, t] {
+      List<std::string, Alloc> list{Alloc(storage)};
+      for (int i = 0; i < count; ++i) {
+        list.push_back(std::to_string(int(t) * count + i));
+      }
+      while (list.size() != 0) {
+        list.pop_front();
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+}  // namespace
+
+int main() {
+  const int count = 50'000;
+  unsigned most = std::max(4u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= most; threads *= 2) {
+    ConcurrentStackStorage<1024> concurrent;
+    ThreadCachedStackStorage<1024> cached;
+    std::printf("%2u threads  concurrent %.3f  thread-cached %.3f\n", threads,
+                Seconds(concurrent, threads, count),
+                Seconds(cached, threads, count));
+  }
+}
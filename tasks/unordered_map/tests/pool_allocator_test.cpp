@@ -0,0 +1,161 @@
+// g++ -std=c++17 -O1 -fsanitize=address,undefined pool_allocator_test.cpp
+#include "../unordered_map.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+
+size_t heap_allocations = 0;
+size_t heap_frees = 0;
+
+}  // namespace
+
+void* operator new(size_t bytes) {
+  ++heap_allocations;
+  if (void* ptr = std::malloc(bytes)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  heap_frees += ptr != nullptr;
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  heap_frees += ptr != nullptr;
+  std::free(ptr);
+}
+
+// PoolAllocator sends arrays here
+void* operator new(size_t bytes, std::align_val_t alignment) {
+  ++heap_allocations;
+  size_t align = size_t(alignment);
+  bytes = (bytes + align - 1) / align * align;
+  if (void* ptr = std::aligned_alloc(align, bytes)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  heap_frees += ptr != nullptr;
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  heap_frees += ptr != nullptr;
+  std::free(ptr);
+}
+
+namespace {
+
+struct alignas(64) Wide {
+  char bytes[64];
+};
+
+void TestListReusesSlots() {
+  PoolStorage storage;
+  List<long, PoolAllocator<long>> list{PoolAllocator<long>(storage)};
+  for (int i = 0; i < 1000; ++i) {
+    list.push_back(i);
+  }
+  while (list.size() != 0) {
+    list.pop_front();
+  }
+  size_t before = heap_allocations;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 1000; ++i) {
+      list.push_back(i);
+    }
+    while (list.size() != 0) {
+      list.pop_back();
+    }
+  }
+  assert(heap_allocations == before);
+}
+
+void TestListCopy() {
+  PoolStorage storage;
+  List<long, PoolAllocator<long>> list{PoolAllocator<long>(storage)};
+  for (int i = 0; i < 100; ++i) {
+    list.push_back(i);
+  }
+  List<long, PoolAllocator<long>> copy = list;
+  assert(copy.get_allocator() == list.get_allocator());
+  long sum = 0;
+  for (long value : copy) {
+    sum += value;
+  }
+  assert(copy.size() == 100 && sum == 4950);
+}
+
+void TestOverAligned() {
+  PoolStorage storage;
+  List<Wide, PoolAllocator<Wide>> list{PoolAllocator<Wide>(storage)};
+  for (int i = 0; i < 100; ++i) {
+    list.push_back(Wide{});
+    assert(reinterpret_cast<uintptr_t>(&*(--list.end())) % alignof(Wide) ==
+           0);
+  }
+}
+
+void TestMapCopy() {
+  using Alloc = PoolAllocator<std::pair<const int, std::string>>;
+  using Map =
+      UnorderedMap<int, std::string, std::hash<int>, std::equal_to<int>, Alloc>;
+  PoolStorage storage;
+  Map map{Alloc(storage)};
+  for (int i = 0; i < 1000; ++i) {
+    map.insert({i, std::to_string(i)});
+  }
+  Map copy = map;
+  assert(copy.size() == 1000);
+  for (int i = 0; i < 1000; ++i) {
+    assert(copy.at(i) == std::to_string(i));
+  }
+  copy.at(7) = "seven";
+  assert(map.at(7) == "7");
+
+  Map assigned{Alloc(storage)};
+  assigned = copy;
+  assert(assigned.size() == 1000 && assigned.at(7) == "seven");
+  Map moved = std::move(assigned);
+  assert(moved.size() == 1000 && moved.at(999) == "999");
+}
+
+// the bucket arrays of a rehash go back to the heap
+void TestMapRehash() {
+  using Alloc = PoolAllocator<std::pair<const int, std::string>>;
+  using Map =
+      UnorderedMap<int, std::string, std::hash<int>, std::equal_to<int>, Alloc>;
+  PoolStorage storage;
+  Map map{Alloc(storage)};
+  for (int i = 0; i < 1000; ++i) {
+    map.insert({i, std::to_string(i)});
+  }
+  size_t live = heap_allocations - heap_frees;
+  for (int round = 0; round < 100; ++round) {
+    map.rehash(4096);
+    map.rehash(1024);
+  }
+  assert(heap_allocations - heap_frees == live);
+  assert(map.size() == 1000 && map.at(500) == "500");
+}
+
+}  // namespace
+
+int main() {
+  TestListReusesSlots();
+  TestListCopy();
+  TestOverAligned();
+  TestMapCopy();
+  TestMapRehash();
+  std::puts("ok");
+}
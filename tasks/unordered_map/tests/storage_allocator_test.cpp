@@ -0,0 +1,85 @@
+// g++ -std=c++17 -O1 -pthread -fsanitize=address,undefined
+//     storage_allocator_test.cpp
+#include "../unordered_map.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+template <typename Storage>
+void FillLists(Storage& storage, int threads, int count) {
+  using Alloc = StorageAllocator<std::string, Storage>;
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&storage, t, count] {
+      List<std::string, Alloc> list{Alloc(storage)};
+      for (int i = 0; i < count; ++i) {
+        list.push_back(std::to_string(t * count + i));
+      }
+      int i = 0;
+      for (const std::string& value : list) {
+        assert(value == std::to_string(t * count + i++));
+      }
+      List<std::string, Alloc> copy = list;
+      assert(copy.size() == list.size() && *copy.begin() == *list.begin());
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+template <typename Storage>
+void TestMapCopy(Storage& storage) {
+  using Alloc = StorageAllocator<std::pair<const int, std::string>, Storage>;
+  using Map =
+      UnorderedMap<int, std::string, std::hash<int>, std::equal_to<int>, Alloc>;
+  Map map{Alloc(storage)};
+  for (int i = 0; i < 1000; ++i) {
+    map.insert({i, std::to_string(i)});
+  }
+  Map copy = map;
+  assert(copy.size() == 1000);
+  for (int i = 0; i < 1000; ++i) {
+    assert(copy.at(i) == std::to_string(i));
+  }
+  copy.at(1) = "one";
+  assert(map.at(1) == "1");
+  map = copy;
+  assert(map.at(1) == "one");
+}
+
+void TestAlignment() {
+  ConcurrentStackStorage<64> storage;
+  for (int i = 0; i < 1000; ++i) {
+    void* ptr = storage.Allocate(24, 128);
+    assert(reinterpret_cast<uintptr_t>(ptr) % 128 == 0);
+  }
+}
+
+}  // namespace
+
+int main() {
+  for (int threads : {1, 2, 4}) {
+    ConcurrentStackStorage<1024> concurrent;
+    FillLists(concurrent, threads, 10000);
+    concurrent.Release();
+    FillLists(concurrent, threads, 1000);
+
+    ThreadCachedStackStorage<1024> cached;
+    FillLists(cached, threads, 10000);
+    cached.Release();
+    FillLists(cached, threads, 1000);
+  }
+  ConcurrentStackStorage<4096> concurrent;
+  TestMapCopy(concurrent);
+  ThreadCachedStackStorage<4096> cached;
+  TestMapCopy(cached);
+  TestAlignment();
+  std::puts("ok");
+}